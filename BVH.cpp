@@ -0,0 +1,127 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <limits>
+
+void BVH::clear() {
+	nodes.clear();
+	order.clear();
+	item_leaf.clear();
+	item_min.clear();
+	item_max.clear();
+}
+
+void BVH::build(std::vector< glm::vec3 > const &mins, std::vector< glm::vec3 > const &maxs) {
+	assert(mins.size() == maxs.size());
+
+	clear();
+	item_min = mins;
+	item_max = maxs;
+	item_leaf.assign(mins.size(), -1U);
+
+	order.reserve(mins.size());
+	for (uint32_t i = 0; i < mins.size(); ++i) {
+		order.emplace_back(i);
+	}
+	if (order.empty()) return;
+
+	nodes.reserve(2 * (order.size() / LeafSize + 1));
+
+	//build nodes over order[begin,end), splitting at the median centroid along the widest axis:
+	// (median splits keep the tree balanced, so depth stays well under MaxDepth)
+	struct Build {
+		BVH &bvh;
+		void operator()(uint32_t parent, uint32_t begin, uint32_t end) {
+			uint32_t index = uint32_t(bvh.nodes.size());
+			bvh.nodes.emplace_back();
+			bvh.nodes[index].parent = parent;
+
+			glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+			glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+			glm::vec3 center_min = min;
+			glm::vec3 center_max = max;
+			for (uint32_t i = begin; i < end; ++i) {
+				uint32_t item = bvh.order[i];
+				min = glm::min(min, bvh.item_min[item]);
+				max = glm::max(max, bvh.item_max[item]);
+				glm::vec3 center = 0.5f * (bvh.item_min[item] + bvh.item_max[item]);
+				center_min = glm::min(center_min, center);
+				center_max = glm::max(center_max, center);
+			}
+			bvh.nodes[index].min = min;
+			bvh.nodes[index].max = max;
+
+			if (end - begin <= LeafSize) {
+				bvh.nodes[index].first = begin;
+				bvh.nodes[index].count = end - begin;
+				for (uint32_t i = begin; i < end; ++i) {
+					bvh.item_leaf[bvh.order[i]] = index;
+				}
+				return;
+			}
+
+			glm::vec3 extent = center_max - center_min;
+			uint32_t axis = 0;
+			if (extent.y > extent[axis]) axis = 1;
+			if (extent.z > extent[axis]) axis = 2;
+
+			uint32_t mid = begin + (end - begin) / 2;
+			std::nth_element(bvh.order.begin() + begin, bvh.order.begin() + mid, bvh.order.begin() + end, [this,axis](uint32_t a, uint32_t b) {
+				return bvh.item_min[a][axis] + bvh.item_max[a][axis] < bvh.item_min[b][axis] + bvh.item_max[b][axis];
+			});
+
+			(*this)(index, begin, mid); //left child is always index+1
+			bvh.nodes[index].right = uint32_t(bvh.nodes.size());
+			(*this)(index, mid, end);
+		}
+	};
+	Build{*this}(-1U, 0, uint32_t(order.size()));
+}
+
+void BVH::refit(uint32_t item, glm::vec3 const &min, glm::vec3 const &max) {
+	assert(item < item_min.size());
+	item_min[item] = min;
+	item_max[item] = max;
+
+	//recompute leaf box from its items:
+	uint32_t index = item_leaf[item];
+	{
+		Node &leaf = nodes[index];
+		glm::vec3 leaf_min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 leaf_max = glm::vec3(-std::numeric_limits< float >::infinity());
+		for (uint32_t i = leaf.first; i < leaf.first + leaf.count; ++i) {
+			leaf_min = glm::min(leaf_min, item_min[order[i]]);
+			leaf_max = glm::max(leaf_max, item_max[order[i]]);
+		}
+		if (leaf_min == leaf.min && leaf_max == leaf.max) return;
+		leaf.min = leaf_min;
+		leaf.max = leaf_max;
+	}
+
+	//walk toward the root, stopping once a node's box doesn't change:
+	index = nodes[index].parent;
+	while (index != -1U) {
+		Node &node = nodes[index];
+		Node const &left = nodes[index + 1];
+		Node const &right = nodes[node.right];
+		glm::vec3 node_min = glm::min(left.min, right.min);
+		glm::vec3 node_max = glm::max(left.max, right.max);
+		if (node_min == node.min && node_max == node.max) break;
+		node.min = node_min;
+		node.max = node_max;
+		index = node.parent;
+	}
+}
+
+bool BVH::ray_hits_box(glm::vec3 const &start, glm::vec3 const &inv_direction, float max_t, glm::vec3 const &min, glm::vec3 const &max, float *t_) {
+	//slab test:
+	glm::vec3 t0 = (min - start) * inv_direction;
+	glm::vec3 t1 = (max - start) * inv_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far = glm::max(t0, t1);
+	float enter = std::max(0.0f, std::max(t_near.x, std::max(t_near.y, t_near.z)));
+	float exit = std::min(max_t, std::min(t_far.x, std::min(t_far.y, t_far.z)));
+	if (enter > exit) return false;
+	if (t_) *t_ = enter;
+	return true;
+}
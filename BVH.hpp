@@ -0,0 +1,177 @@
+#pragma once
+
+/*
+ * BVH is a bounding volume hierarchy over a set of axis-aligned boxes ("items").
+ *
+ * Items are identified by their index in the arrays passed to build();
+ *  the tree is rebuilt with build() when items are added or removed, and
+ *  individual item boxes can be moved cheaply with refit().
+ *
+ * Queries call a callback for every item whose box passes the test.
+ *
+ * (Scene uses a BVH over its drawables for culling and picking.)
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct BVH {
+	//(re-)build the hierarchy over boxes [mins[i], maxs[i]]:
+	void build(std::vector< glm::vec3 > const &mins, std::vector< glm::vec3 > const &maxs);
+
+	//change the box of a single item, updating the boxes of the nodes containing it:
+	void refit(uint32_t item, glm::vec3 const &min, glm::vec3 const &max);
+
+	//remove all items:
+	void clear();
+
+	uint32_t size() const { return uint32_t(item_min.size()); }
+
+	//call fn(item) for every item whose box is not entirely outside of all the planes:
+	// (planes are (a,b,c,d) with a*x + b*y + c*z + d >= 0 being "inside")
+	// returns the number of node boxes tested against the planes
+	template< typename F >
+	uint32_t query_planes(glm::vec4 const *planes, uint32_t plane_count, F const &fn) const;
+
+	//call fn(item, &max_t) for every item whose box is hit by ray start + t * direction, t in [0, max_t]:
+	// (fn may reduce max_t to prune the remaining search, e.g. when looking for the closest hit)
+	template< typename F >
+	void query_ray(glm::vec3 const &start, glm::vec3 const &direction, float max_t, F const &fn) const;
+
+	//call fn(item) for every item whose box overlaps the sphere:
+	template< typename F >
+	void query_sphere(glm::vec3 const &center, float radius, F const &fn) const;
+
+	//helper: does ray start + t * direction (with inv_direction = 1 / direction) hit [min,max] for t in [0,max_t]?
+	// if so, sets *t to the entry time
+	static bool ray_hits_box(glm::vec3 const &start, glm::vec3 const &inv_direction, float max_t, glm::vec3 const &min, glm::vec3 const &max, float *t);
+
+	//-- internals --
+
+	enum : uint32_t { LeafSize = 4, MaxDepth = 64 };
+
+	//nodes are stored in depth-first order, so the left child of node i is always i+1:
+	struct Node {
+		glm::vec3 min, max;
+		uint32_t parent = -1U;
+		uint32_t right = -1U; //index of right child (interior nodes only)
+		uint32_t first = 0; //first entry in 'order' (leaf nodes only)
+		uint32_t count = 0; //number of entries in 'order' (zero for interior nodes)
+	};
+	std::vector< Node > nodes;
+
+	std::vector< uint32_t > order; //item indices, grouped by leaf
+	std::vector< uint32_t > item_leaf; //leaf node containing each item
+	std::vector< glm::vec3 > item_min, item_max; //box of each item
+};
+
+//------------------------------------------------------
+
+template< typename F >
+uint32_t BVH::query_planes(glm::vec4 const *planes, uint32_t plane_count, F const &fn) const {
+	if (nodes.empty()) return 0;
+	assert(plane_count <= 32);
+
+	//'mask' tracks which planes still need to be checked; nodes fully inside a plane don't pass it to children:
+	struct Entry { uint32_t node; uint32_t mask; };
+	Entry stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = Entry{ 0, (plane_count == 32 ? ~0U : (1U << plane_count) - 1U) };
+
+	uint32_t tested = 0;
+	while (top) {
+		Entry entry = stack[--top];
+		Node const &node = nodes[entry.node];
+		tested += 1;
+
+		glm::vec3 center = 0.5f * (node.max + node.min);
+		glm::vec3 radius = 0.5f * (node.max - node.min);
+		bool outside = false;
+		uint32_t mask = entry.mask;
+		for (uint32_t p = 0; p < plane_count; ++p) {
+			if (!(mask & (1U << p))) continue;
+			glm::vec4 const &plane = planes[p];
+			float d = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float r = std::abs(plane.x) * radius.x + std::abs(plane.y) * radius.y + std::abs(plane.z) * radius.z;
+			if (d + r < 0.0f) { outside = true; break; }
+			if (d - r >= 0.0f) mask &= ~(1U << p); //entirely inside this plane
+		}
+		if (outside) continue;
+
+		if (node.count) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				fn(order[i]);
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			stack[top++] = Entry{ node.right, mask };
+			stack[top++] = Entry{ entry.node + 1, mask };
+		}
+	}
+	return tested;
+}
+
+template< typename F >
+void BVH::query_ray(glm::vec3 const &start, glm::vec3 const &direction, float max_t, F const &fn) const {
+	if (nodes.empty()) return;
+	glm::vec3 inv_direction = 1.0f / direction;
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		float t;
+		if (!ray_hits_box(start, inv_direction, max_t, node.min, node.max, &t)) continue;
+		if (node.count) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = order[i];
+				if (ray_hits_box(start, inv_direction, max_t, item_min[item], item_max[item], &t)) {
+					fn(item, &max_t);
+				}
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			stack[top++] = node.right;
+			stack[top++] = index + 1;
+		}
+	}
+}
+
+template< typename F >
+void BVH::query_sphere(glm::vec3 const &center, float radius, F const &fn) const {
+	if (nodes.empty()) return;
+
+	auto overlaps = [&center, &radius](glm::vec3 const &min, glm::vec3 const &max) {
+		glm::vec3 close = glm::clamp(center, min, max);
+		glm::vec3 to = close - center;
+		return glm::dot(to, to) <= radius * radius;
+	};
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		if (!overlaps(node.min, node.max)) continue;
+		if (node.count) {
+			for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+				uint32_t item = order[i];
+				if (overlaps(item_min[item], item_max[item])) fn(item);
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			stack[top++] = node.right;
+			stack[top++] = index + 1;
+		}
+	}
+}
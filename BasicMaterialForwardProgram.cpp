@@ -1,5 +1,6 @@
 #include "BasicMaterialForwardProgram.hpp"
 
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -11,9 +12,8 @@ Load< BasicMaterialForwardProgram > basic_material_forward_program(LoadTagEarly,
 	//----- build the pipeline template -----
 	basic_material_forward_program_pipeline.program = ret->program;
 
-	basic_material_forward_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	basic_material_forward_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	basic_material_forward_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//object matrices are supplied via the "Object" uniform block:
+	basic_material_forward_program_pipeline.object_block = true;
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -40,9 +40,7 @@ BasicMaterialForwardProgram::BasicMaterialForwardProgram() {
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		+ ObjectBlockGLSL +
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
@@ -64,13 +62,7 @@ BasicMaterialForwardProgram::BasicMaterialForwardProgram() {
 		"#line " STR(__LINE__) "\n"
 		"uniform sampler2D TEX;\n"
 		"uniform float ROUGHNESS;\n"
-		"uniform uint LIGHTS;\n"
-		"uniform int LIGHT_TYPE[" + std::to_string(MaxLights) + "];\n"
-		"uniform vec3 LIGHT_LOCATION[" + std::to_string(MaxLights) + "];\n"
-		"uniform vec3 LIGHT_DIRECTION[" + std::to_string(MaxLights) + "];\n"
-		"uniform vec3 LIGHT_ENERGY[" + std::to_string(MaxLights) + "];\n"
-		"uniform float LIGHT_CUTOFF[" + std::to_string(MaxLights) + "];\n"
-		"uniform vec3 EYE;\n"
+		+ FrameBlockGLSL +
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -83,11 +75,11 @@ BasicMaterialForwardProgram::BasicMaterialForwardProgram() {
 		"	vec3 v = normalize(EYE - position);\n"
 		"	vec3 total = vec3(0.0f); //total light output\n"
 		"	for (uint light = 0u; light < LIGHTS; ++light) {\n"
-		"		int TYPE = LIGHT_TYPE[light];\n"
-		"		vec3 LOCATION = LIGHT_LOCATION[light];\n"
-		"		vec3 DIRECTION = LIGHT_DIRECTION[light];\n"
-		"		vec3 ENERGY = LIGHT_ENERGY[light];\n"
-		"		float CUTOFF = LIGHT_CUTOFF[light];\n"
+		"		int TYPE = LIGHT[light].TYPE;\n"
+		"		vec3 LOCATION = LIGHT[light].LOCATION;\n"
+		"		vec3 DIRECTION = LIGHT[light].DIRECTION;\n"
+		"		vec3 ENERGY = LIGHT[light].ENERGY;\n"
+		"		float CUTOFF = LIGHT[light].CUTOFF;\n"
 		"		vec3 l; //direction to light\n"
 		"		vec3 h; //half-vector\n"
 		"		vec3 e; //light flux\n"
@@ -137,22 +129,10 @@ BasicMaterialForwardProgram::BasicMaterialForwardProgram() {
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
 	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
-
 	ROUGHNESS_float = glGetUniformLocation(program, "ROUGHNESS");
 
-	EYE_vec3 = glGetUniformLocation(program, "EYE");
-
-	LIGHTS_uint = glGetUniformLocation(program, "LIGHTS");
-
-	LIGHT_TYPE_int_array = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3_array = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3_array = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3_array = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float_array = glGetUniformLocation(program, "LIGHT_CUTOFF");
-
+	//attach uniform blocks to their binding points:
+	bind_uniform_blocks(program);
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
@@ -3,6 +3,7 @@
 #include "GL.hpp"
 #include "Load.hpp"
 #include "Scene.hpp"
+#include "UniformBlocks.hpp"
 
 //Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
 struct BasicMaterialForwardProgram {
@@ -18,25 +19,15 @@ struct BasicMaterialForwardProgram {
 	GLuint TexCoord_vec2 = -1U;
 
 	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
 
 	//  material uniforms:
 	GLuint ROUGHNESS_float = -1U;
 
-	//  lighting uniforms:
-	GLuint EYE_vec3 = -1U; //camera position in lighting space
+	//Uniform blocks (see UniformBlocks.hpp):
+	//  Object - object-to-clip, object-to-light, and normal-to-light matrices (set by Scene::draw)
+	//  Frame - eye position and lights (set with set_frame_block)
 
-	GLuint LIGHTS_uint = -1U;
-
-	GLuint LIGHT_TYPE_int_array = -1U;
-	GLuint LIGHT_LOCATION_vec3_array = -1U;
-	GLuint LIGHT_DIRECTION_vec3_array = -1U;
-	GLuint LIGHT_ENERGY_vec3_array = -1U;
-	GLuint LIGHT_CUTOFF_float_array = -1U;
-
-	enum : uint32_t { MaxLights = 40 };
+	enum : uint32_t { MaxLights = FrameBlock::MaxLights };
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
@@ -1,5 +1,6 @@
 #include "BasicMaterialProgram.hpp"
 
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -11,9 +12,8 @@ Load< BasicMaterialProgram > basic_material_program(LoadTagEarly, []() -> BasicM
 	//----- build the pipeline template -----
 	basic_material_program_pipeline.program = ret->program;
 
-	basic_material_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	basic_material_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	basic_material_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//object matrices are supplied via the "Object" uniform block:
+	basic_material_program_pipeline.object_block = true;
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -40,9 +40,7 @@ BasicMaterialProgram::BasicMaterialProgram() {
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		+ ObjectBlockGLSL +
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
@@ -63,12 +61,7 @@ BasicMaterialProgram::BasicMaterialProgram() {
 		"#version 330\n"
 		"uniform sampler2D TEX;\n"
 		"uniform float ROUGHNESS;\n"
-		"uniform int LIGHT_TYPE;\n"
-		"uniform vec3 LIGHT_LOCATION;\n"
-		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
-		"uniform float LIGHT_CUTOFF;\n"
-		"uniform vec3 EYE;\n"
+		+ FrameBlockGLSL +
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -79,6 +72,11 @@ BasicMaterialProgram::BasicMaterialProgram() {
 		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
 		"	vec3 n = normalize(normal);\n"
 		"	vec3 v = normalize(EYE - position);\n"
+		"	int LIGHT_TYPE = LIGHT[0].TYPE; //(one light per pass)\n"
+		"	vec3 LIGHT_LOCATION = LIGHT[0].LOCATION;\n"
+		"	vec3 LIGHT_DIRECTION = LIGHT[0].DIRECTION;\n"
+		"	vec3 LIGHT_ENERGY = LIGHT[0].ENERGY;\n"
+		"	float LIGHT_CUTOFF = LIGHT[0].CUTOFF;\n"
 		"	vec3 l; //direction to light\n"
 		"	vec3 h; //half-vector\n"
 		"	vec3 e; //light flux\n"
@@ -126,20 +124,10 @@ BasicMaterialProgram::BasicMaterialProgram() {
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
 	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
-
 	ROUGHNESS_float = glGetUniformLocation(program, "ROUGHNESS");
 
-	EYE_vec3 = glGetUniformLocation(program, "EYE");
-
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
-
+	//attach uniform blocks to their binding points:
+	bind_uniform_blocks(program);
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
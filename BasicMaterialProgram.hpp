@@ -18,21 +18,13 @@ struct BasicMaterialProgram {
 	GLuint TexCoord_vec2 = -1U;
 
 	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
 
 	//  material uniforms:
 	GLuint ROUGHNESS_float = -1U;
 
-	//  lighting uniforms:
-	GLuint EYE_vec3 = -1U; //camera position in lighting space
-
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
-	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
+	//Uniform blocks (see UniformBlocks.hpp):
+	//  Object - object-to-clip, object-to-light, and normal-to-light matrices (set by Scene::draw)
+	//  Frame - eye position and the light for this pass, in light[0] (set with set_frame_block)
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
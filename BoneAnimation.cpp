@@ -3,19 +3,16 @@
 #include "read_write_chunk.hpp"
 #include "gl_errors.hpp"
 
-#include <glm/gtc/type_ptr.hpp>
-
 #include <set>
-#include <fstream>
 #include <algorithm>
 
 BoneAnimation::BoneAnimation(std::string const &filename) {
 	std::cout << "Reading bone-based animation from '" << filename << "'." << std::endl;
 
-	std::ifstream file(filename, std::ios::binary);
+	//file contents are used in place (see ChunkReader in read_write_chunk.hpp):
+	ChunkReader file(filename);
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	ChunkSpan< char > strings = file.read< char >("str0");
 
 	{ //read bones:
 		struct BoneInfo {
@@ -25,8 +22,7 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(BoneInfo) == 4*2 + 4 + 4*12, "BoneInfo is packed.");
 
-		std::vector< BoneInfo > file_bones;
-		read_chunk(file, "bon0", &file_bones);
+		ChunkSpan< BoneInfo > file_bones = file.read< BoneInfo >("bon0");
 		bones.reserve(file_bones.size());
 		for (auto const &file_bone : file_bones) {
 			if (!(file_bone.name_begin <= file_bone.name_end && file_bone.name_end <= strings.size())) {
@@ -37,19 +33,50 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 			}
 			bones.emplace_back();
 			Bone &bone = bones.back();
-			bone.name = std::string(&strings[0] + file_bone.name_begin, &strings[0] + file_bone.name_end);
+			bone.name = std::string(strings.begin() + file_bone.name_begin, strings.begin() + file_bone.name_end);
 			bone.parent = file_bone.parent;
 			bone.inverse_bind_matrix = file_bone.inverse_bind_matrix;
 		}
 	}
 
+	//palette cache space is allocated up front, so drawing never allocates:
+	for (auto &cached : palette_cache) {
+		cached.palette.resize(bones.size());
+	}
+
 	static_assert(sizeof(PoseBone) == 3*4 + 4*4 + 3*4, "PoseBone is packed.");
-	read_chunk(file, "frm0", &frame_bones);
-	if (frame_bones.size() % bones.size() != 0) {
-		throw std::runtime_error("frame bones is not divisible by bones");
+	static_assert(sizeof(glm::u16vec3) == 3*2, "key values are packed.");
+	//poses are kept, so these are the chunks that are copied:
+	if (file.peek() == "frm0") {
+		ChunkSpan< PoseBone > file_frame_bones = file.read< PoseBone >("frm0");
+		frame_bones.assign(file_frame_bones.begin(), file_frame_bones.end());
+		if (frame_bones.size() % bones.size() != 0) {
+			throw std::runtime_error("frame bones is not divisible by bones");
+		}
+	} else { //compressed tracks (written by compress-banims):
+		ChunkSpan< BoneAnimationTrack > file_tracks = file.read< BoneAnimationTrack >("trk0");
+		ChunkSpan< uint16_t > file_key_times = file.read< uint16_t >("ktm0");
+		ChunkSpan< glm::u16vec3 > file_key_values = file.read< glm::u16vec3 >("kvl0");
+		tracks.assign(file_tracks.begin(), file_tracks.end());
+		key_times.assign(file_key_times.begin(), file_key_times.end());
+		key_values.assign(file_key_values.begin(), file_key_values.end());
+		if (key_times.size() != key_values.size()) {
+			throw std::runtime_error("key times and values have different sizes");
+		}
+		for (auto const &track : tracks) {
+			if (!(track.key_count >= 1 && track.first_key <= key_times.size() && track.key_count <= key_times.size() - track.first_key)) {
+				throw std::runtime_error("track has out-of-range keys");
+			}
+			for (uint32_t k = track.first_key + 1; k < track.first_key + track.key_count; ++k) {
+				if (!(key_times[k-1] < key_times[k])) {
+					throw std::runtime_error("track has out-of-order keys");
+				}
+			}
+		}
 	}
 
-	uint32_t frames = uint32_t(frame_bones.size() / bones.size());
+	//(compressed files have no frames outside of animations, so only animation lengths are limited)
+	uint32_t frames = (tracks.empty() ? uint32_t(frame_bones.size() / bones.size()) : -1U);
 
 	{ //read actions (animations):
 		struct AnimationInfo {
@@ -58,8 +85,7 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(AnimationInfo) == 4*2 + 4*2, "AnimationInfo is packed.");
 
-		std::vector< AnimationInfo > file_animations;
-		read_chunk(file, "act0", &file_animations);
+		ChunkSpan< AnimationInfo > file_animations = file.read< AnimationInfo >("act0");
 		animations.reserve(file_animations.size());
 		for (auto const &file_animation : file_animations) {
 			if (!(file_animation.name_begin <= file_animation.name_end && file_animation.name_end <= strings.size())) {
@@ -70,12 +96,33 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 			}
 			animations.emplace_back();
 			Animation &animation = animations.back();
-			animation.name = std::string(&strings[0] + file_animation.name_begin, &strings[0] + file_animation.name_end);
+			animation.name = std::string(strings.begin() + file_animation.name_begin, strings.begin() + file_animation.name_end);
 			animation.begin = file_animation.begin;
 			animation.end = file_animation.end;
 		}
 	}
 
+	if (!tracks.empty()) { //each animation has a track per channel of every bone, in order:
+		uint32_t per_animation = uint32_t(bones.size()) * BoneAnimationTrack::Channels;
+		if (tracks.size() != animations.size() * per_animation) {
+			throw std::runtime_error("track count does not match animations and bones");
+		}
+		for (uint32_t a = 0; a < animations.size(); ++a) {
+			Animation &animation = animations[a];
+			animation.first_track = a * per_animation;
+			if (animation.end - animation.begin > 0x10000) {
+				throw std::runtime_error("compressed animation is longer than key times can count");
+			}
+			uint32_t length = std::max(animation.end - animation.begin, 1U);
+			for (uint32_t t = animation.first_track; t < animation.first_track + per_animation; ++t) {
+				BoneAnimationTrack const &track = tracks[t];
+				if (key_times[track.first_key + track.key_count - 1] >= length) {
+					throw std::runtime_error("track has keys past the end of its animation");
+				}
+			}
+		}
+	}
+
 	{ //read actual mesh:
 		struct Vertex {
 			glm::vec3 Position;
@@ -87,8 +134,7 @@ BoneAnimation::BoneAnimation(std::string const &filename) {
 		};
 		static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4+4*4+4*4, "Vertex is packed.");
 		//GLAttribBuffer< glm::vec3, glm::vec3, glm::u8vec4, glm::vec2, glm::vec4, glm::uvec4 > buffer;
-		std::vector< Vertex > data;
-		read_chunk(file, "msh0", &data);
+		ChunkSpan< Vertex > data = file.read< Vertex >("msh0");
 
 		//check bone indices:
 		for (auto const &vertex : data) {
@@ -154,32 +200,93 @@ GLuint BoneAnimation::make_vao_for_program(GLuint program) const {
 	return ::make_vao_for_program(attribs, program);
 }
 
-// - - - - - - - - - - - - - - - - - - - - - - - - -
+//stored frames on either side of 'frame' (for files with every frame);
+// returns the interpolation amount from *f0 to *f1:
+static float frames_around(BoneAnimation::Animation const &anim, float frame, uint32_t *f0, uint32_t *f1) {
+	float first = std::floor(frame);
+	*f0 = uint32_t(std::max(0.0f, first));
+	*f0 = std::max(anim.begin, std::min(*f0, anim.end - 1));
+	*f1 = std::min(*f0 + 1, anim.end - 1);
+	return frame - first;
+}
 
-BoneAnimationPlayer::BoneAnimationPlayer(BoneAnimation const &banims_, BoneAnimation::Animation const &anim_, LoopOrOnce loop_or_once_, float speed) : banims(banims_), anim(anim_), loop_or_once(loop_or_once_) {
-	set_speed(speed);
+static BoneAnimation::PoseBone mix_pose_bones(BoneAnimation::PoseBone const &a, BoneAnimation::PoseBone const &b, float amt) {
+	BoneAnimation::PoseBone ret;
+	ret.position = glm::mix(a.position, b.position, amt);
+	ret.rotation = glm::slerp(a.rotation, b.rotation, amt);
+	ret.scale = glm::mix(a.scale, b.scale, amt);
+	return ret;
 }
 
-void BoneAnimationPlayer::update(float elapsed) {
-	position += elapsed * position_per_second;
-	if (loop_or_once == Loop) {
-		position -= std::floor(position);
-	} else { //(loop_or_once == Once)
-		position = std::max(std::min(position, 1.0f), 0.0f);
+void BoneAnimation::sample(Animation const &anim, float frame, PoseBone *pose) const {
+	if (tracks.empty()) {
+		//interpolate between the stored frames on either side:
+		uint32_t f0, f1;
+		float amt = frames_around(anim, frame, &f0, &f1);
+
+		PoseBone const *pose0 = get_frame(f0);
+		if (f0 == f1 || !(amt > 0.0f)) {
+			std::copy(pose0, pose0 + bones.size(), pose);
+			return;
+		}
+		PoseBone const *pose1 = get_frame(f1);
+		for (uint32_t b = 0; b < bones.size(); ++b) {
+			pose[b] = mix_pose_bones(pose0[b], pose1[b], amt);
+		}
+	} else {
+		//sample every track (key times are counted from the start of the animation):
+		float local = frame - float(anim.begin);
+		BoneAnimationTrack const *track = &tracks[anim.first_track];
+		for (uint32_t b = 0; b < bones.size(); ++b) {
+			pose[b].position = sample_track_vec3(track[BoneAnimationTrack::Position], key_times.data(), key_values.data(), local);
+			pose[b].rotation = sample_track_quat(track[BoneAnimationTrack::Rotation], key_times.data(), key_values.data(), local);
+			pose[b].scale = sample_track_vec3(track[BoneAnimationTrack::Scale], key_times.data(), key_values.data(), local);
+			track += BoneAnimationTrack::Channels;
+		}
+	}
+}
+
+BoneAnimation::PoseBone BoneAnimation::sample_bone(Animation const &anim, float frame, uint32_t bone) const {
+	if (tracks.empty()) {
+		uint32_t f0, f1;
+		float amt = frames_around(anim, frame, &f0, &f1);
+
+		PoseBone const &pose0 = get_frame(f0)[bone];
+		if (f0 == f1 || !(amt > 0.0f)) return pose0;
+		return mix_pose_bones(pose0, get_frame(f1)[bone], amt);
+	} else {
+		float local = frame - float(anim.begin);
+		BoneAnimationTrack const *track = &tracks[anim.first_track + bone * BoneAnimationTrack::Channels];
+		PoseBone ret;
+		ret.position = sample_track_vec3(track[BoneAnimationTrack::Position], key_times.data(), key_values.data(), local);
+		ret.rotation = sample_track_quat(track[BoneAnimationTrack::Rotation], key_times.data(), key_values.data(), local);
+		ret.scale = sample_track_vec3(track[BoneAnimationTrack::Scale], key_times.data(), key_values.data(), local);
+		return ret;
 	}
 }
 
-void BoneAnimationPlayer::set_uniform(GLint bones_mat4x3_array) const {
-	std::vector< glm::mat4x3 > bone_to_object(banims.bones.size()); //needed for hierarchy
-	std::vector< glm::mat4x3 > bones(banims.bones.size()); //actual uniforms
+std::vector< float > BoneAnimation::make_mask(std::string const &bone_name) const {
+	std::vector< float > mask(bones.size(), 0.0f);
+	bool found = false;
+	//(parents come before their children, so one pass reaches every descendant)
+	for (uint32_t b = 0; b < bones.size(); ++b) {
+		if (bones[b].name == bone_name) {
+			mask[b] = 1.0f;
+			found = true;
+		} else if (bones[b].parent != -1U && mask[bones[b].parent] == 1.0f) {
+			mask[b] = 1.0f;
+		}
+	}
+	if (!found) {
+		throw std::runtime_error("Bone with name '" + bone_name + "' does not exist.");
+	}
+	return mask;
+}
 
-	int32_t frame = int32_t(std::floor((anim.end - 1 - anim.begin) * position + anim.begin));
-	if (frame < int32_t(anim.begin)) frame = anim.begin;
-	if (frame > int32_t(anim.end)-1) frame = int32_t(anim.end)-1;
-	BoneAnimation::PoseBone const *pose = banims.get_frame(frame);
+void BoneAnimation::compute_palette(PoseBone const *pose, glm::mat4x3 *palette, glm::mat4x3 *bone_to_object) const {
 	for (uint32_t b = 0; b < bones.size(); ++b) {
-		BoneAnimation::PoseBone const &pose_bone = pose[b];
-		BoneAnimation::Bone const &bone = banims.bones[b];
+		PoseBone const &pose_bone = pose[b];
+		Bone const &bone = bones[b];
 
 		glm::mat3 r = glm::mat3_cast(pose_bone.rotation);
 		glm::mat3 rs = glm::mat3(
@@ -197,7 +304,170 @@ void BoneAnimationPlayer::set_uniform(GLint bones_mat4x3_array) const {
 		} else {
 			bone_to_object[b] = bone_to_object[bone.parent] * glm::mat4(trs);
 		}
-		bones[b] = bone_to_object[b] * glm::mat4(bone.inverse_bind_matrix);
+		palette[b] = bone_to_object[b] * glm::mat4(bone.inverse_bind_matrix);
+	}
+}
+
+void BoneAnimation::get_palette(Animation const &anim, float frame, glm::mat4x3 *palette, glm::mat4x3 *bone_to_object, PoseBone *pose) const {
+	for (auto const &cached : palette_cache) {
+		if (cached.anim == &anim && cached.frame == frame) {
+			std::copy(cached.palette.begin(), cached.palette.end(), palette);
+			return;
+		}
+	}
+
+	if (tracks.empty() && frame == std::floor(frame)) {
+		//whole frames can use stored poses directly:
+		compute_palette(get_frame(uint32_t(frame)), palette, bone_to_object);
+	} else {
+		sample(anim, frame, pose);
+		compute_palette(pose, palette, bone_to_object);
+	}
+
+	CachedPalette &cached = palette_cache[palette_cache_next];
+	palette_cache_next = (palette_cache_next + 1) % PaletteCacheSize;
+	cached.anim = &anim;
+	cached.frame = frame;
+	std::copy(palette, palette + bones.size(), cached.palette.begin());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - -
+
+//position and frame helpers shared by players and their layers:
+static void advance_position(float *position, float position_per_second, BoneAnimationPlayer::LoopOrOnce loop_or_once, float elapsed) {
+	*position += elapsed * position_per_second;
+	if (loop_or_once == BoneAnimationPlayer::Loop) {
+		*position -= std::floor(*position);
+	} else { //(loop_or_once == Once)
+		*position = std::max(std::min(*position, 1.0f), 0.0f);
+	}
+}
+
+static float frame_at_position(BoneAnimation::Animation const &anim, float position) {
+	float frame = (anim.end - 1 - anim.begin) * position + anim.begin;
+	if (frame < float(anim.begin)) frame = float(anim.begin);
+	if (frame > float(anim.end - 1)) frame = float(anim.end - 1);
+	return frame;
+}
+
+BoneAnimationPlayer::BoneAnimationPlayer(BoneAnimation const &banims_, BoneAnimation::Animation const &anim_, LoopOrOnce loop_or_once_, float speed) : banims(banims_), anim(&anim_), loop_or_once(loop_or_once_) {
+	set_speed(speed);
+	palette.resize(banims.bones.size());
+	bone_to_object.resize(banims.bones.size());
+	pose.resize(banims.bones.size());
+	evaluate();
+}
+
+BoneAnimationPlayer::Layer::Layer(BoneAnimation::Animation const &anim_, LoopOrOnce loop_or_once_, float speed) : anim(&anim_), loop_or_once(loop_or_once_) {
+	set_speed(speed);
+}
+
+float BoneAnimationPlayer::Layer::current_frame() const {
+	return frame_at_position(*anim, position);
+}
+
+void BoneAnimationPlayer::crossfade(BoneAnimation::Animation const &to, float duration, LoopOrOnce loop_or_once_, float speed) {
+	layers.emplace_back(to, loop_or_once_, speed);
+	Layer &layer = layers.back();
+	if (duration > 0.0f) {
+		layer.weight = 0.0f;
+		layer.fade_per_second = 1.0f / duration;
+	} else {
+		layer.weight = 1.0f;
+		layer.fade_per_second = 1.0f;
+	}
+	update(0.0f); //(switches right away if the layer is already at full weight)
+}
+
+void BoneAnimationPlayer::update(float elapsed) {
+	advance_position(&position, position_per_second, loop_or_once, elapsed);
+	if (layers.empty()) return;
+
+	for (auto &layer : layers) {
+		advance_position(&layer.position, layer.position_per_second, layer.loop_or_once, elapsed);
+		layer.weight = std::max(std::min(layer.weight + elapsed * layer.fade_per_second, 1.0f), 0.0f);
+	}
+
+	//layers that have faded out are removed:
+	layers.erase(std::remove_if(layers.begin(), layers.end(), [](Layer const &layer) {
+		return layer.fade_per_second < 0.0f && layer.weight <= 0.0f;
+	}), layers.end());
+
+	//the topmost layer that has faded in over everything below it replaces them:
+	for (uint32_t i = uint32_t(layers.size()); i > 0; --i) {
+		Layer const &layer = layers[i-1];
+		if (layer.fade_per_second > 0.0f && layer.weight >= 1.0f && layer.mode == Layer::Blend && layer.mask.empty()) {
+			anim = layer.anim;
+			position = layer.position;
+			position_per_second = layer.position_per_second;
+			loop_or_once = layer.loop_or_once;
+			layers.erase(layers.begin(), layers.begin() + i);
+			break;
+		}
+	}
+}
+
+float BoneAnimationPlayer::current_frame() const {
+	return frame_at_position(*anim, position);
+}
+
+bool BoneAnimationPlayer::blended() const {
+	for (auto const &layer : layers) {
+		if (layer.weight > 0.0f) return true;
+	}
+	return false;
+}
+
+void BoneAnimationPlayer::blend_pose() {
+	//layers below an unmasked Blend layer at full weight are hidden, so start from the topmost such layer:
+	BoneAnimation::Animation const *base = anim;
+	float base_frame = current_frame();
+	uint32_t first = 0;
+	for (uint32_t i = 0; i < layers.size(); ++i) {
+		Layer const &layer = layers[i];
+		if (layer.weight >= 1.0f && layer.mode == Layer::Blend && layer.mask.empty()) {
+			base = layer.anim;
+			base_frame = layer.current_frame();
+			first = i + 1;
+		}
+	}
+
+	for (uint32_t b = 0; b < pose.size(); ++b) {
+		BoneAnimation::PoseBone bone = banims.sample_bone(*base, base_frame, b);
+		for (uint32_t i = first; i < layers.size(); ++i) {
+			Layer const &layer = layers[i];
+			float weight = layer.weight;
+			if (!layer.mask.empty()) weight *= layer.mask[b];
+			if (!(weight > 0.0f)) continue;
+
+			BoneAnimation::PoseBone layer_bone = banims.sample_bone(*layer.anim, layer.current_frame(), b);
+			if (layer.mode == Layer::Blend) {
+				bone = mix_pose_bones(bone, layer_bone, weight);
+			} else { //(layer.mode == Layer::Additive)
+				//difference from the layer animation's first frame:
+				BoneAnimation::PoseBone reference = banims.sample_bone(*layer.anim, float(layer.anim->begin), b);
+				glm::quat delta = glm::inverse(reference.rotation) * layer_bone.rotation;
+				bone.position += weight * (layer_bone.position - reference.position);
+				bone.rotation = bone.rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), delta, weight);
+				//(a zero reference scale has no meaningful ratio, so that component is left alone)
+				glm::vec3 ratio;
+				ratio.x = (reference.scale.x == 0.0f ? 1.0f : layer_bone.scale.x / reference.scale.x);
+				ratio.y = (reference.scale.y == 0.0f ? 1.0f : layer_bone.scale.y / reference.scale.y);
+				ratio.z = (reference.scale.z == 0.0f ? 1.0f : layer_bone.scale.z / reference.scale.z);
+				bone.scale *= glm::mix(glm::vec3(1.0f), ratio, weight);
+			}
+		}
+		pose[b] = bone;
+	}
+}
+
+void BoneAnimationPlayer::evaluate() {
+	if (palette.empty()) return;
+	if (!blended()) {
+		banims.get_palette(*anim, current_frame(), palette.data(), bone_to_object.data(), pose.data());
+	} else {
+		//(blended poses depend on every layer, so aren't cached)
+		blend_pose();
+		banims.compute_palette(pose.data(), palette.data(), bone_to_object.data());
 	}
-	glUniformMatrix4x3fv(bones_mat4x3_array, GLsizei(bones.size()), GL_FALSE, glm::value_ptr(bones[0]));
 }
@@ -2,6 +2,7 @@
 
 #include "Mesh.hpp"
 #include "make_vao_for_program.hpp"
+#include "BoneAnimationTracks.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
@@ -33,7 +34,7 @@ struct BoneAnimation {
 	};
 	std::vector< Bone > bones;
 
-	//Animation poses:
+	//Animation poses, either every bone of every frame ('frm0' chunk)...
 	struct PoseBone {
 		glm::vec3 position;
 		glm::quat rotation;
@@ -41,15 +42,22 @@ struct BoneAnimation {
 	};
 	std::vector< PoseBone > frame_bones;
 
+	//(only for files with every frame; see sample())
 	PoseBone const *get_frame(uint32_t frame) const {
 		return &frame_bones[frame * bones.size()];
 	}
 
+	// ...or compressed tracks of keys (see BoneAnimationTracks.hpp), in which case frame_bones is empty:
+	std::vector< BoneAnimationTrack > tracks;
+	std::vector< uint16_t > key_times;
+	std::vector< glm::u16vec3 > key_values;
+
 	//Animation index:
 	struct Animation {
 		std::string name;
 		uint32_t begin = 0;
 		uint32_t end = 0;
+		uint32_t first_track = -1U; //first of this animation's tracks (if compressed)
 	};
 
 	std::vector< Animation > animations;
@@ -66,6 +74,38 @@ struct BoneAnimation {
 	//  will throw if program defines attributes not contained in this buffer
 	//  and warn if this buffer contains attributes not active in the program
 	GLuint make_vao_for_program(GLuint program) const;
+
+	//compute the pose at a (possibly fractional) frame of an animation into 'pose' (bones.size() entries):
+	//  'frame' is in [anim.begin, anim.end-1]; poses are interpolated between frames or keys
+	void sample(Animation const &anim, float frame, PoseBone *pose) const;
+
+	//compute just one bone of the pose at 'frame' of 'anim' (e.g., for blending several animations bone by bone):
+	PoseBone sample_bone(Animation const &anim, float frame, uint32_t bone) const;
+
+	//per-bone weights (e.g., for BoneAnimationPlayer::Layer::mask):
+	//  1 for the named bone and its descendants, 0 for every other bone; will throw if the bone is not found
+	std::vector< float > make_mask(std::string const &bone_name) const;
+
+	//Skinning palettes (bone_to_object * inverse_bind_matrix for every bone):
+
+	//compute the palette for a pose into 'palette' (bones.size() matrices):
+	//  'bone_to_object' (also bones.size() matrices) is scratch space for walking the hierarchy
+	void compute_palette(PoseBone const *pose, glm::mat4x3 *palette, glm::mat4x3 *bone_to_object) const;
+
+	//copy the palette for 'frame' of 'anim' into 'palette', computing it only if it isn't cached:
+	//  (players showing the same frame -- e.g., a crowd of identical props -- share one evaluation)
+	//  'pose' (bones.size() entries) is scratch space for sample()
+	void get_palette(Animation const &anim, float frame, glm::mat4x3 *palette, glm::mat4x3 *bone_to_object, PoseBone *pose) const;
+
+	//recently-used palettes, replaced round-robin:
+	enum : uint32_t { PaletteCacheSize = 8 };
+	struct CachedPalette {
+		Animation const *anim = nullptr; //nullptr if unused
+		float frame = 0.0f;
+		std::vector< glm::mat4x3 > palette; //bones.size() matrices, allocated at load
+	};
+	mutable CachedPalette palette_cache[PaletteCacheSize];
+	mutable uint32_t palette_cache_next = 0;
 };
 
 struct BoneAnimationPlayer {
@@ -73,19 +113,74 @@ struct BoneAnimationPlayer {
 	BoneAnimationPlayer(BoneAnimation const &banims, BoneAnimation::Animation const &anim, LoopOrOnce loop_or_once = Once, float speed = 1.0f);
 
 	BoneAnimation const &banims;
-	BoneAnimation::Animation const &anim;
+	BoneAnimation::Animation const *anim; //(changes when a crossfade finishes)
 
 	void set_speed(float speed, float fps = 24.0f) {
-		position_per_second = speed / ((anim.end-1-anim.begin) / fps);
+		position_per_second = speed / ((anim->end-1-anim->begin) / fps);
 	}
 
 	float position = 0.0f; //from 0.0 == beginning to 1.0 == end
 	float position_per_second = 1.0f;
 	LoopOrOnce loop_or_once = Once;
 
+	//Layers, applied in order on top of 'anim' (the bottom layer):
+	//  each bone is blended through every layer as it is sampled, so only the final pose is stored
+	struct Layer {
+		Layer(BoneAnimation::Animation const &anim, LoopOrOnce loop_or_once = Once, float speed = 1.0f);
+
+		BoneAnimation::Animation const *anim;
+
+		void set_speed(float speed, float fps = 24.0f) {
+			position_per_second = speed / ((anim->end-1-anim->begin) / fps);
+		}
+
+		float position = 0.0f; //from 0.0 == beginning to 1.0 == end (like the player's)
+		float position_per_second = 1.0f;
+		LoopOrOnce loop_or_once = Once;
+
+		//Blend layers mix from the result so far toward their pose by 'weight'
+		//  (so clips 0..N with weights w_i summing to one blend by giving layer i weight w_i / (w_0 + ... + w_i));
+		//Additive layers add 'weight' times their pose's difference from their animation's first frame:
+		enum Mode { Blend, Additive } mode = Blend;
+		float weight = 1.0f; //in [0,1]; layers with zero weight are skipped
+
+		//weight change per second (e.g., from crossfade()):
+		//  a layer fading out is removed when its weight reaches zero;
+		//  an unmasked Blend layer fading in hides everything below it once its weight reaches one, so it becomes the player's animation
+		float fade_per_second = 0.0f;
+
+		//per-bone weight multipliers (bones.size() entries; see BoneAnimation::make_mask), or empty for every bone:
+		std::vector< float > mask;
+
+		float current_frame() const;
+	};
+	std::vector< Layer > layers;
+
+	//blend from the current animation (and layers) to 'anim' over 'duration' seconds:
+	//  (adds a Blend layer fading in; a duration of zero switches immediately)
+	void crossfade(BoneAnimation::Animation const &anim, float duration, LoopOrOnce loop_or_once = Once, float speed = 1.0f);
+
+	//advances position, layer positions, and fades:
 	void update(float elapsed);
 
-	void set_uniform(GLint bones_mat4x3_array) const;
+	//compute the skinning palette for the current position:
+	//  (call after update() and before drawing; does not allocate)
+	//  (see BoneAnimationBatch for evaluating many players at once, and for uploading palettes for drawing)
+	void evaluate();
+
+	//palette, hierarchy, and pose scratch space, allocated at construction:
+	std::vector< glm::mat4x3 > palette;
+	std::vector< glm::mat4x3 > bone_to_object;
+	std::vector< BoneAnimation::PoseBone > pose;
+
+	//(fractional) frame of the current position:
+	float current_frame() const;
+
+	//true if any layer has weight -- otherwise only 'anim' is evaluated, at the same cost as a player without layers:
+	bool blended() const;
+
+	//compute the pose of 'anim' with every layer applied into 'pose':
+	void blend_pose();
 
 	bool done() const { return (loop_or_once == Once && position >= 1.0f); }
 
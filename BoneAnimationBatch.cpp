@@ -0,0 +1,264 @@
+#include "BoneAnimationBatch.hpp"
+
+#include "gl_errors.hpp"
+#include "Lanes.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+
+static_assert(BoneAnimationBatch::PlayersPerJob % LaneCount == 0, "jobs are whole lane groups");
+
+//an affine matrix (glm::mat4x3 layout: four columns of three) with one player per lane:
+struct LaneMatrix {
+	Lanes m[12];
+
+	void load(float const *from) { //from [12][LaneCount] floats
+		for (uint32_t k = 0; k < 12; ++k) m[k] = lanes_load(from + k * LaneCount);
+	}
+	void store(float *to) const {
+		for (uint32_t k = 0; k < 12; ++k) lanes_store(to + k * LaneCount, m[k]);
+	}
+
+	//this * (c0 c1 c2 c3), where the columns' fourth rows are (0 0 0 1):
+	template< typename Column >
+	LaneMatrix times(Column const &c0, Column const &c1, Column const &c2, Column const &c3) const {
+		LaneMatrix ret;
+		Column const *c[4] = { &c0, &c1, &c2, &c3 };
+		for (uint32_t j = 0; j < 4; ++j) {
+			for (uint32_t r = 0; r < 3; ++r) {
+				ret.m[j*3+r] = m[0*3+r] * (*c[j])[0] + m[1*3+r] * (*c[j])[1] + m[2*3+r] * (*c[j])[2];
+			}
+		}
+		for (uint32_t r = 0; r < 3; ++r) {
+			ret.m[3*3+r] = ret.m[3*3+r] + m[3*3+r];
+		}
+		return ret;
+	}
+};
+
+struct LaneVec3 {
+	Lanes v[3];
+	Lanes const &operator[](uint32_t i) const { return v[i]; }
+};
+
+//------------------------------------------------------
+
+BoneAnimationBatch::BoneAnimationBatch() {
+	glGenBuffers(1, &palette_buffer);
+	glGenTextures(1, &palette_texture);
+
+	//(start with one bone's worth of space, so the texture is never empty)
+	glBindBuffer(GL_TEXTURE_BUFFER, palette_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 3 * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, palette_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	GL_ERRORS();
+}
+
+BoneAnimationBatch::~BoneAnimationBatch() {
+	glDeleteTextures(1, &palette_texture);
+	palette_texture = 0;
+	glDeleteBuffers(1, &palette_buffer);
+	palette_buffer = 0;
+}
+
+uint32_t BoneAnimationBatch::add(BoneAnimationPlayer *player) {
+	assert(player);
+	uint32_t base = palette_size;
+	players.emplace_back(player);
+	palette_bases.emplace_back(base);
+	palette_size += uint32_t(player->palette.size());
+	return base;
+}
+
+void BoneAnimationBatch::upload() {
+	if (palette_size == 0) return;
+
+	//rows of every matrix, in player order:
+	palette_data.clear();
+	palette_data.reserve(3 * palette_size);
+	for (auto player : players) {
+		for (auto const &m : player->palette) {
+			for (uint32_t r = 0; r < 3; ++r) {
+				palette_data.emplace_back(m[0][r], m[1][r], m[2][r], m[3][r]);
+			}
+		}
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, palette_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, palette_data.size() * sizeof(glm::vec4), palette_data.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	GL_ERRORS();
+}
+
+//------------------------------------------------------
+
+static bool shows_same(BoneAnimationBatch::Entry const &a, BoneAnimationBatch::Entry const &b) {
+	//(blended players depend on their layers too, so are always evaluated)
+	if (a.player->blended() || b.player->blended()) return false;
+	return &a.player->banims == &b.player->banims && a.player->anim == b.player->anim && a.frame == b.frame;
+}
+
+void BoneAnimationBatch::evaluate(WorkerPool *pool) {
+	entries.clear();
+	for (auto player : players) {
+		if (player->palette.empty()) continue;
+		entries.emplace_back(Entry{player, player->current_frame(), nullptr});
+	}
+
+	//sort so that players with the same skeleton, animation, and frame are adjacent:
+	std::sort(entries.begin(), entries.end(), [](Entry const &a, Entry const &b) {
+		std::less< void const * > before;
+		if (&a.player->banims != &b.player->banims) return before(&a.player->banims, &b.player->banims);
+		if (a.player->anim != b.player->anim) return before(a.player->anim, b.player->anim);
+		return a.frame < b.frame;
+	});
+
+	//evaluate only the first of each run:
+	evaluated.clear();
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		if (i == 0 || !shows_same(entries[i-1], entries[i])) evaluated.emplace_back(i);
+	}
+
+	//jobs are runs of evaluated entries with the same skeleton:
+	jobs.clear();
+	uint32_t max_bones = 0;
+	for (uint32_t i = 0; i < evaluated.size(); ) {
+		BoneAnimation const &banims = entries[evaluated[i]].player->banims;
+		uint32_t count = 1;
+		while (i + count < evaluated.size() && count < PlayersPerJob && &entries[evaluated[i + count]].player->banims == &banims) {
+			++count;
+		}
+		jobs.emplace_back(Job{i, count});
+		max_bones = std::max(max_bones, uint32_t(banims.bones.size()));
+		i += count;
+	}
+
+	job_scratch = max_bones * 12 * LaneCount;
+	if (scratch.size() < jobs.size() * job_scratch) scratch.resize(jobs.size() * job_scratch);
+
+	if (!pool || pool->size() == 1) {
+		for (uint32_t job = 0; job < jobs.size(); ++job) {
+			run_job(job);
+		}
+	} else {
+		pool->run(uint32_t(jobs.size()), [this](uint32_t job) {
+			run_job(job);
+		});
+	}
+
+	//players showing the same thing as an evaluated player copy its palette:
+	uint32_t source = 0;
+	for (uint32_t i = 1; i < entries.size(); ++i) {
+		if (!shows_same(entries[source], entries[i])) {
+			source = i;
+			continue;
+		}
+		auto const &from = entries[source].player->palette;
+		std::copy(from.begin(), from.end(), entries[i].player->palette.begin());
+	}
+}
+
+void BoneAnimationBatch::run_job(uint32_t job_index) {
+	Job const &job = jobs[job_index];
+	BoneAnimation const &banims = entries[evaluated[job.first]].player->banims;
+	uint32_t bones = uint32_t(banims.bones.size());
+	float *to_object = scratch.data() + job_index * job_scratch; //[bones][12][LaneCount]
+
+	//sample poses (whole frames of uncompressed animations are used in place):
+	for (uint32_t i = job.first; i < job.first + job.count; ++i) {
+		Entry &entry = entries[evaluated[i]];
+		BoneAnimationPlayer &player = *entry.player;
+		if (player.blended()) {
+			player.blend_pose();
+			entry.pose = player.pose.data();
+		} else if (banims.tracks.empty() && entry.frame == std::floor(entry.frame)) {
+			entry.pose = banims.get_frame(uint32_t(entry.frame));
+		} else {
+			banims.sample(*player.anim, entry.frame, player.pose.data());
+			entry.pose = player.pose.data();
+		}
+	}
+
+	//walk the hierarchy for LaneCount players at a time:
+	for (uint32_t group = 0; group < job.count; group += LaneCount) {
+		uint32_t active = std::min(LaneCount, job.count - group);
+
+		//(unused lanes repeat the last player, and their results are ignored)
+		BoneAnimation::PoseBone const *poses[LaneCount];
+		glm::mat4x3 *palettes[LaneCount];
+		for (uint32_t l = 0; l < LaneCount; ++l) {
+			Entry const &entry = entries[evaluated[job.first + group + std::min(l, active - 1)]];
+			poses[l] = entry.pose;
+			palettes[l] = entry.player->palette.data();
+		}
+
+		for (uint32_t b = 0; b < bones; ++b) {
+			BoneAnimation::Bone const &bone = banims.bones[b];
+			LaneMatrix bone_to_object;
+
+			if (bone.parent == -1U) {
+				//root position is cleared (as in BoneAnimation::compute_palette):
+				for (uint32_t k = 0; k < 12; ++k) {
+					bone_to_object.m[k] = lanes_set(k % 4 == 0 ? 1.0f : 0.0f);
+				}
+			} else {
+				//gather pose bone b of every lane:
+				float gathered[10][LaneCount];
+				for (uint32_t l = 0; l < LaneCount; ++l) {
+					BoneAnimation::PoseBone const &pose = poses[l][b];
+					gathered[0][l] = pose.position.x;
+					gathered[1][l] = pose.position.y;
+					gathered[2][l] = pose.position.z;
+					gathered[3][l] = pose.rotation.x;
+					gathered[4][l] = pose.rotation.y;
+					gathered[5][l] = pose.rotation.z;
+					gathered[6][l] = pose.rotation.w;
+					gathered[7][l] = pose.scale.x;
+					gathered[8][l] = pose.scale.y;
+					gathered[9][l] = pose.scale.z;
+				}
+				Lanes x = lanes_load(gathered[3]), y = lanes_load(gathered[4]), z = lanes_load(gathered[5]), w = lanes_load(gathered[6]);
+				Lanes sx = lanes_load(gathered[7]), sy = lanes_load(gathered[8]), sz = lanes_load(gathered[9]);
+
+				//rotation * scale (as glm::mat3_cast, with columns scaled):
+				Lanes one = lanes_set(1.0f), two = lanes_set(2.0f);
+				Lanes xx = x * x, yy = y * y, zz = z * z;
+				Lanes xy = x * y, xz = x * z, yz = y * z;
+				Lanes wx = w * x, wy = w * y, wz = w * z;
+				LaneVec3 c0{{ (one - two * (yy + zz)) * sx, two * (xy + wz) * sx, two * (xz - wy) * sx }};
+				LaneVec3 c1{{ two * (xy - wz) * sy, (one - two * (xx + zz)) * sy, two * (yz + wx) * sy }};
+				LaneVec3 c2{{ two * (xz + wy) * sz, two * (yz - wx) * sz, (one - two * (xx + yy)) * sz }};
+				LaneVec3 c3{{ lanes_load(gathered[0]), lanes_load(gathered[1]), lanes_load(gathered[2]) }};
+
+				LaneMatrix parent;
+				parent.load(to_object + bone.parent * 12 * LaneCount);
+				bone_to_object = parent.times(c0, c1, c2, c3);
+			}
+			bone_to_object.store(to_object + b * 12 * LaneCount);
+
+			//palette = bone_to_object * inverse_bind_matrix (the same for every lane):
+			glm::mat4x3 const &ib = bone.inverse_bind_matrix;
+			LaneVec3 ib_columns[4];
+			for (uint32_t j = 0; j < 4; ++j) {
+				ib_columns[j] = LaneVec3{{ lanes_set(ib[j].x), lanes_set(ib[j].y), lanes_set(ib[j].z) }};
+			}
+			LaneMatrix palette = bone_to_object.times(ib_columns[0], ib_columns[1], ib_columns[2], ib_columns[3]);
+
+			//scatter to players:
+			float out[12][LaneCount];
+			for (uint32_t k = 0; k < 12; ++k) lanes_store(out[k], palette.m[k]);
+			for (uint32_t l = 0; l < active; ++l) {
+				float *dst = &palettes[l][b][0][0];
+				for (uint32_t k = 0; k < 12; ++k) dst[k] = out[k][l];
+			}
+		}
+	}
+}
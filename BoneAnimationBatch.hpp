@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+ * BoneAnimationBatch computes the skinning palettes of many
+ *  BoneAnimationPlayers at once (e.g., a crowd), as a separate step before
+ *  drawing starts:
+ *  - players showing the same frame of the same animation (without blend
+ *    layers) are evaluated once, and the result is copied to the rest;
+ *  - the remaining players are split into jobs by skeleton (BoneAnimation);
+ *  - in each job, players' poses are sampled one player at a time (see
+ *    BoneAnimation::sample and BoneAnimationPlayer::blend_pose), then the
+ *    hierarchy is walked for several players at once: each bone's
+ *    rotation/scale/translation, bone-to-object, and palette matrices are
+ *    kept structure-of-arrays across SIMD lanes, so one instruction
+ *    computes the same matrix entry for LaneCount players;
+ *  - if a WorkerPool is given, jobs are spread over its threads.
+ *
+ * upload() then copies every palette into one buffer texture, so skinned
+ *  drawables can find their bones by palette base -- and drawables sharing
+ *  a mesh can be drawn with one instanced draw (see
+ *  BoneLitColorTextureProgram).
+ *
+ * Each player's palette ends up the same as BoneAnimationPlayer::evaluate()
+ *  would compute (up to rounding), and doesn't depend on how players were
+ *  grouped or how many threads ran.
+ *
+ */
+
+#include "BoneAnimation.hpp"
+#include "WorkerPool.hpp"
+#include "GL.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct BoneAnimationBatch {
+	//creates the palette buffer texture (so needs an OpenGL context):
+	BoneAnimationBatch();
+	~BoneAnimationBatch();
+
+	BoneAnimationBatch(BoneAnimationBatch const &) = delete;
+	BoneAnimationBatch &operator=(BoneAnimationBatch const &) = delete;
+
+	//add a player (not owned; must outlive the batch):
+	//  returns the index of its first bone in the palette buffer (e.g., for Drawable::instance_data)
+	uint32_t add(BoneAnimationPlayer *player);
+
+	//players, in the order they were added, and where their palettes start in the palette buffer:
+	std::vector< BoneAnimationPlayer * > players;
+	std::vector< uint32_t > palette_bases;
+
+	//compute every player's palette for its current position:
+	//  (call after updating players and before drawing)
+	void evaluate(WorkerPool *pool = nullptr);
+
+	//copy every player's palette into the palette buffer:
+	//  (call after evaluate() and before drawing)
+	void upload();
+
+	//buffer of all palettes, in player order; each bone's matrix is three RGBA32F texels (its rows):
+	//  (bind palette_texture as a GL_TEXTURE_BUFFER; n.b. OpenGL 3.3 only promises 65536 texels, though most implementations allow far more)
+	GLuint palette_buffer = 0;
+	GLuint palette_texture = 0;
+
+	//-- internals --
+
+	//players per job (a multiple of the SIMD lane count):
+	enum : uint32_t { PlayersPerJob = 64 };
+
+	struct Entry {
+		BoneAnimationPlayer *player;
+		float frame;
+		BoneAnimation::PoseBone const *pose; //filled in by the job that evaluates this entry
+	};
+	std::vector< Entry > entries; //sorted so that players showing the same thing are adjacent
+	std::vector< uint32_t > evaluated; //first entry of each run of players showing the same thing, grouped by skeleton
+
+	struct Job {
+		uint32_t first, count; //range of 'evaluated'
+	};
+	std::vector< Job > jobs;
+
+	//per-job bone-to-object matrices, structure-of-arrays ([bones][12][LaneCount] floats per job):
+	std::vector< float > scratch;
+	uint32_t job_scratch = 0; //floats of scratch per job
+
+	void run_job(uint32_t job);
+
+	uint32_t palette_size = 0; //total bones of all players
+	std::vector< glm::vec4 > palette_data; //scratch for upload()
+};
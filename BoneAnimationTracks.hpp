@@ -0,0 +1,138 @@
+#pragma once
+
+/*
+ * Compressed bone animation tracks, as written into '.banims' files by
+ *  compress-banims and read by BoneAnimation.
+ *
+ * Every animation has a position, rotation, and scale track for each bone.
+ *  A track is a run of keys; each key is a frame (counted from the start of
+ *  the animation) and a value packed into three 16-bit numbers:
+ *  - positions and scales are 16-bit fractions of the track's
+ *    [min, min + extent] box;
+ *  - rotations are stored "smallest three" style: the three smallest
+ *    quaternion components get 15 bits each, the remaining bits say which
+ *    component was left out, and that component (made positive, since
+ *    q and -q are the same rotation) is recovered from unit length.
+ *
+ * Between keys, positions and scales are linearly interpolated and rotations
+ *  are slerp'd. Before the first key and after the last, the nearest key is
+ *  held, so a track that doesn't change is a single key.
+ *
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+struct BoneAnimationTrack {
+	//tracks for bone 'b' of an animation are at animation.first_track + b * Channels + channel:
+	enum Channel : uint32_t { Position = 0, Rotation = 1, Scale = 2, Channels = 3 };
+
+	uint32_t first_key, key_count; //keys [first_key, first_key + key_count) of the key time and value chunks
+	glm::vec3 min, extent; //box that position and scale values are fractions of (unused for rotations)
+};
+static_assert(sizeof(BoneAnimationTrack) == 4*2 + 4*3*2, "BoneAnimationTrack is packed.");
+
+//positions and scales:
+
+inline glm::u16vec3 pack_track_vec3(glm::vec3 const &v, glm::vec3 const &min, glm::vec3 const &extent) {
+	glm::u16vec3 ret;
+	for (uint32_t c = 0; c < 3; ++c) {
+		float f = (extent[c] > 0.0f ? (v[c] - min[c]) / extent[c] : 0.0f);
+		f = std::max(0.0f, std::min(1.0f, f));
+		ret[c] = uint16_t(std::round(f * 65535.0f));
+	}
+	return ret;
+}
+
+inline glm::vec3 unpack_track_vec3(glm::u16vec3 const &p, glm::vec3 const &min, glm::vec3 const &extent) {
+	return min + extent * (glm::vec3(p) * (1.0f / 65535.0f));
+}
+
+//rotations:
+
+inline glm::u16vec3 pack_track_quat(glm::quat const &q) {
+	float c[4] = { q.x, q.y, q.z, q.w };
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; ++i) {
+		if (std::abs(c[i]) > std::abs(c[largest])) largest = i;
+	}
+	//normalize and flip so the largest component is positive:
+	float len = std::sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2] + c[3]*c[3]);
+	float scale = (c[largest] < 0.0f ? -1.0f : 1.0f) / len;
+
+	//the other components are in [-1/sqrt(2), 1/sqrt(2)]:
+	uint16_t packed[3];
+	uint32_t o = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (i == largest) continue;
+		float f = c[i] * scale * (1.41421356f * 0.5f) + 0.5f;
+		f = std::max(0.0f, std::min(1.0f, f));
+		packed[o++] = uint16_t(std::round(f * 32767.0f));
+	}
+
+	return glm::u16vec3(
+		packed[0] | uint16_t((largest & 1) << 15),
+		packed[1] | uint16_t((largest >> 1) << 15),
+		packed[2]
+	);
+}
+
+inline glm::quat unpack_track_quat(glm::u16vec3 const &p) {
+	uint32_t largest = (p.x >> 15) | ((p.y >> 15) << 1);
+	float small[3] = { float(p.x & 0x7fff), float(p.y & 0x7fff), float(p.z & 0x7fff) };
+	float sum2 = 0.0f;
+	for (auto &s : small) {
+		s = (s * (2.0f / 32767.0f) - 1.0f) * 0.70710678f;
+		sum2 += s * s;
+	}
+	float c[4];
+	uint32_t o = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		c[i] = (i == largest ? std::sqrt(std::max(0.0f, 1.0f - sum2)) : small[o++]);
+	}
+	return glm::quat(c[3], c[0], c[1], c[2]); //n.b. wxyz init order
+}
+
+//sampling:
+
+//find the keys around 'frame' (counted from the start of the animation);
+// returns the interpolation amount from key *k0 to key *k1:
+inline float find_track_keys(BoneAnimationTrack const &track, uint16_t const *key_times, float frame, uint32_t *k0, uint32_t *k1) {
+	uint16_t const *begin = key_times + track.first_key;
+	uint16_t const *end = begin + track.key_count;
+	//first key after 'frame':
+	uint16_t const *after = std::upper_bound(begin, end, frame, [](float f, uint16_t t) {
+		return f < float(t);
+	});
+	if (after == begin) {
+		*k0 = *k1 = track.first_key;
+		return 0.0f;
+	}
+	if (after == end) {
+		*k0 = *k1 = track.first_key + track.key_count - 1;
+		return 0.0f;
+	}
+	*k1 = uint32_t(after - key_times);
+	*k0 = *k1 - 1;
+	return (frame - float(key_times[*k0])) / float(key_times[*k1] - key_times[*k0]);
+}
+
+inline glm::vec3 sample_track_vec3(BoneAnimationTrack const &track, uint16_t const *key_times, glm::u16vec3 const *key_values, float frame) {
+	uint32_t k0, k1;
+	float amt = find_track_keys(track, key_times, frame, &k0, &k1);
+	glm::vec3 v0 = unpack_track_vec3(key_values[k0], track.min, track.extent);
+	if (k0 == k1) return v0;
+	return glm::mix(v0, unpack_track_vec3(key_values[k1], track.min, track.extent), amt);
+}
+
+inline glm::quat sample_track_quat(BoneAnimationTrack const &track, uint16_t const *key_times, glm::u16vec3 const *key_values, float frame) {
+	uint32_t k0, k1;
+	float amt = find_track_keys(track, key_times, frame, &k0, &k1);
+	glm::quat q0 = unpack_track_quat(key_values[k0]);
+	if (k0 == k1) return q0;
+	return glm::slerp(q0, unpack_track_quat(key_values[k1]), amt);
+}
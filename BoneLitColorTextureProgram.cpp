@@ -14,6 +14,10 @@ Load< BoneLitColorTextureProgram > bone_lit_color_texture_program(LoadTagEarly,
 	bone_lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
 	bone_lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
 	bone_lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	bone_lit_color_texture_program_pipeline.INSTANCE_DATA_int = ret->PALETTE_BASE_int;
+
+	bone_lit_color_texture_program_pipeline.instanced.program = ret->instanced_program;
+	bone_lit_color_texture_program_pipeline.instanced.INSTANCE_BASE_int = ret->instanced_INSTANCE_BASE_int;
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -35,26 +39,42 @@ Load< BoneLitColorTextureProgram > bone_lit_color_texture_program(LoadTagEarly,
 	return ret;
 });
 
-BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
-		//vertex shader:
-		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
-		"uniform mat4x3 BONES[" + std::to_string(MaxBones) + "];\n"
-		"in vec4 Position;\n"
-		"in vec3 Normal;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
-		"in vec4 BoneWeights;\n"
-		"in uvec4 BoneIndices;\n"
-		"out vec3 position;\n"
-		"out vec3 normal;\n"
-		"out vec4 color;\n"
-		"out vec2 texCoord;\n"
-		"void main() {\n"
+//fragment shader shared by the regular and instanced programs:
+static std::string const BoneLitColorTextureFragmentShader =
+	"#version 330\n"
+	"uniform sampler2D TEX;\n"
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"in vec2 texCoord;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	vec3 n = normalize(normal);\n"
+	"	vec3 l = normalize(vec3(0.1, 0.1, 1.0));\n"
+	"	vec4 albedo = texture(TEX, texCoord) * color;\n"
+	//simple hemispherical lighting model:
+	"	vec3 light = mix(vec3(0.0,0.0,0.1), vec3(1.0,1.0,0.95), dot(n,l)*0.5+0.5);\n"
+	"	fragColor = vec4(light*albedo.rgb, albedo.a);\n"
+	"}\n"
+;
+
+//vertex attributes (with fixed locations so both programs can share vertex array objects) and skinning:
+static std::string const BoneLitColorTextureAttributes =
+	"layout(location=0) in vec4 Position;\n"
+	"layout(location=1) in vec3 Normal;\n"
+	"layout(location=2) in vec4 Color;\n"
+	"layout(location=3) in vec2 TexCoord;\n"
+	"layout(location=4) in vec4 BoneWeights;\n"
+	"layout(location=5) in uvec4 BoneIndices;\n"
+	"out vec3 position;\n"
+	"out vec3 normal;\n"
+	"out vec4 color;\n"
+	"out vec2 texCoord;\n"
+	"uniform samplerBuffer PALETTES;\n"
+	"mat4x3 bone(int palette_base, uint index) {\n"
+	"	int t = 3 * (palette_base + int(index));\n"
+	"	return transpose(mat3x4(texelFetch(PALETTES, t+0), texelFetch(PALETTES, t+1), texelFetch(PALETTES, t+2)));\n"
+	"}\n"
 //Considering (just) the Add/Mul counts:
 /*  Variation (1): mul = 4*(12+3) = 60,  add = 4*9 + 3*3 = 45
 		"	vec3 blended_Position = (\n"
@@ -72,18 +92,39 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 		"		+ BONES[BoneIndices.w] * BoneWeights.w\n"
 		"		) * Position;\n"
 */
-		"	vec3 blended_Position = (\n"
-		"		(BONES[BoneIndices.x] * Position) * BoneWeights.x\n"
-		"		+ (BONES[BoneIndices.y] * Position) * BoneWeights.y\n"
-		"		+ (BONES[BoneIndices.z] * Position) * BoneWeights.z\n"
-		"		+ (BONES[BoneIndices.w] * Position) * BoneWeights.w\n"
-		"		);\n"
-		"	vec3 blended_Normal = (\n"
-		"		mat3(BONES[BoneIndices.x]) * Normal * BoneWeights.x\n"
-		"		+ mat3(BONES[BoneIndices.y]) * Normal * BoneWeights.y\n"
-		"		+ mat3(BONES[BoneIndices.z]) * Normal * BoneWeights.z\n"
-		"		+ mat3(BONES[BoneIndices.w]) * Normal * BoneWeights.w\n"
-		"		);\n"
+	"void skin(int palette_base, out vec3 blended_Position, out vec3 blended_Normal) {\n"
+	"	mat4x3 bx = bone(palette_base, BoneIndices.x);\n"
+	"	mat4x3 by = bone(palette_base, BoneIndices.y);\n"
+	"	mat4x3 bz = bone(palette_base, BoneIndices.z);\n"
+	"	mat4x3 bw = bone(palette_base, BoneIndices.w);\n"
+	"	blended_Position = (\n"
+	"		(bx * Position) * BoneWeights.x\n"
+	"		+ (by * Position) * BoneWeights.y\n"
+	"		+ (bz * Position) * BoneWeights.z\n"
+	"		+ (bw * Position) * BoneWeights.w\n"
+	"		);\n"
+	"	blended_Normal = (\n"
+	"		mat3(bx) * Normal * BoneWeights.x\n"
+	"		+ mat3(by) * Normal * BoneWeights.y\n"
+	"		+ mat3(bz) * Normal * BoneWeights.z\n"
+	"		+ mat3(bw) * Normal * BoneWeights.w\n"
+	"		);\n"
+	"}\n"
+;
+
+BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
+	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
+	program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform mat4 OBJECT_TO_CLIP;\n"
+		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
+		"uniform mat3 NORMAL_TO_LIGHT;\n"
+		"uniform int PALETTE_BASE;\n"
+		+ BoneLitColorTextureAttributes +
+		"void main() {\n"
+		"	vec3 blended_Position, blended_Normal;\n"
+		"	skin(PALETTE_BASE, blended_Position, blended_Normal);\n"
 		"	gl_Position = OBJECT_TO_CLIP * vec4(blended_Position, 1.0);\n"
 		"	position = OBJECT_TO_LIGHT * vec4(blended_Position, 1.0);\n"
 		"	normal = NORMAL_TO_LIGHT * blended_Normal;\n"
@@ -92,21 +133,7 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 		"}\n"
 	,
 		//fragment shader:
-		"#version 330\n"
-		"uniform sampler2D TEX;\n"
-		"in vec3 position;\n"
-		"in vec3 normal;\n"
-		"in vec4 color;\n"
-		"in vec2 texCoord;\n"
-		"out vec4 fragColor;\n"
-		"void main() {\n"
-		"	vec3 n = normalize(normal);\n"
-		"	vec3 l = normalize(vec3(0.1, 0.1, 1.0));\n"
-		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
-		//simple hemispherical lighting model:
-		"	vec3 light = mix(vec3(0.0,0.0,0.1), vec3(1.0,1.0,0.95), dot(n,l)*0.5+0.5);\n"
-		"	fragColor = vec4(light*albedo.rgb, albedo.a);\n"
-		"}\n"
+		BoneLitColorTextureFragmentShader
 	);
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
@@ -123,20 +150,57 @@ BoneLitColorTextureProgram::BoneLitColorTextureProgram() {
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
 	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
 	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
-	BONES_mat4x3_array = glGetUniformLocation(program, "BONES");
+	PALETTE_BASE_int = glGetUniformLocation(program, "PALETTE_BASE");
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+	GLuint PALETTES_samplerBuffer = glGetUniformLocation(program, "PALETTES");
 
-	//set TEX to always refer to texture binding zero:
+	//set TEX to always refer to texture binding zero, and PALETTES to binding one:
 	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+	glUniform1i(PALETTES_samplerBuffer, 1); //set PALETTES to sample from GL_TEXTURE1
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+
+	//The instanced variant reads its matrices (and palette base) from Scene's per-instance buffer:
+	instanced_program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		+ std::string(Scene::InstanceGLSL)
+		+ BoneLitColorTextureAttributes +
+		"void main() {\n"
+		"	vec3 blended_Position, blended_Normal;\n"
+		"	skin(instance_DATA(), blended_Position, blended_Normal);\n"
+		"	gl_Position = instance_OBJECT_TO_CLIP() * vec4(blended_Position, 1.0);\n"
+		"	position = instance_OBJECT_TO_LIGHT() * vec4(blended_Position, 1.0);\n"
+		"	normal = instance_NORMAL_TO_LIGHT() * blended_Normal;\n"
+		"	color = Color;\n"
+		"	texCoord = TexCoord;\n"
+		"}\n"
+	,
+		//fragment shader:
+		BoneLitColorTextureFragmentShader
+	);
+
+	instanced_INSTANCE_BASE_int = glGetUniformLocation(instanced_program, "INSTANCE_BASE");
+	GLuint instanced_INSTANCES_samplerBuffer = glGetUniformLocation(instanced_program, "INSTANCES");
+	GLuint instanced_TEX_sampler2D = glGetUniformLocation(instanced_program, "TEX");
+	GLuint instanced_PALETTES_samplerBuffer = glGetUniformLocation(instanced_program, "PALETTES");
+
+	glUseProgram(instanced_program);
+
+	glUniform1i(instanced_INSTANCES_samplerBuffer, Scene::InstanceTextureUnit);
+	glUniform1i(instanced_TEX_sampler2D, 0);
+	glUniform1i(instanced_PALETTES_samplerBuffer, 1);
+
+	glUseProgram(0);
 }
 
 BoneLitColorTextureProgram::~BoneLitColorTextureProgram() {
 	glDeleteProgram(program);
 	program = 0;
+	glDeleteProgram(instanced_program);
+	instanced_program = 0;
 }
 
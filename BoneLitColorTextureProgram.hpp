@@ -24,18 +24,21 @@ struct BoneLitColorTextureProgram {
 	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
 	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
 
-	GLuint BONES_mat4x3_array = -1U;
-
-	enum : uint32_t {
-		MaxBones = 40
-	};
+	GLuint PALETTE_BASE_int = -1U; //index of the drawable's first bone in PALETTES (set from Drawable::instance_data by Scene::draw)
 
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
+	//TEXTURE1 - buffer texture of bone palettes, three RGBA32F texels (matrix rows) per bone (see BoneAnimationBatch::upload)
+
+	//Instanced variant (same attribute locations; matrices come from Scene's per-instance buffer, palette base from instance_DATA()):
+	// skinned drawables that share a mesh and palette texture are drawn with one instanced draw
+	GLuint instanced_program = 0;
+	GLuint instanced_INSTANCE_BASE_int = -1U;
 };
 
 extern Load< BoneLitColorTextureProgram > bone_lit_color_texture_program;
 
 //For convenient scene-graph setup, copy this object:
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: set textures[1] to the palette buffer texture (e.g., BoneAnimationBatch::palette_texture) and each drawable's instance_data to its palette base.
 extern Scene::Drawable::Pipeline bone_lit_color_texture_program_pipeline;
@@ -0,0 +1,163 @@
+#pragma once
+
+/*
+ * ChunkList< T > is a sequence container used by Scene in place of std::list:
+ *  - elements live contiguously in fixed-size chunks, so iterating touches memory sequentially
+ *  - elements never move once created, so pointers to them (e.g., Transform *) stay valid
+ *  - elements can be addressed by index, and index_of() maps a pointer back to its index
+ *
+ * Like the std::list usage it replaces, elements can only be added at the end
+ *  (or all removed at once with clear()).
+ *
+ * 'generation' changes whenever elements are added or removed, so data kept
+ *  per element elsewhere (e.g., Scene's drawable BVH) can tell it is stale
+ *  without rescanning the list.
+ *
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+template< typename T, uint32_t ChunkSize = 256 >
+struct ChunkList {
+	static_assert((ChunkSize & (ChunkSize - 1)) == 0, "ChunkSize should be a power of two.");
+
+	ChunkList() = default;
+	ChunkList(ChunkList const &other) {
+		*this = other;
+	}
+	ChunkList(ChunkList &&other) {
+		*this = std::move(other);
+	}
+	ChunkList &operator=(ChunkList const &other) {
+		if (&other == this) return *this;
+		clear();
+		for (auto const &value : other) {
+			emplace_back(value);
+		}
+		return *this;
+	}
+	ChunkList &operator=(ChunkList &&other) {
+		if (&other == this) return *this;
+		clear();
+		chunks = std::move(other.chunks);
+		chunk_starts = std::move(other.chunk_starts);
+		count = other.count;
+		generation += 1;
+		other.chunks.clear();
+		other.chunk_starts.clear();
+		other.count = 0;
+		other.generation += 1;
+		return *this;
+	}
+	~ChunkList() {
+		clear();
+	}
+
+	//add an element to the end of the list:
+	template< typename... Args >
+	T &emplace_back(Args&&... args) {
+		if (count == chunks.size() * ChunkSize) {
+			chunks.emplace_back(new Chunk);
+			//keep chunk_starts sorted by address (used by index_of):
+			std::pair< T const *, uint32_t > start(chunks.back()->data(), uint32_t(chunks.size() - 1));
+			chunk_starts.insert(std::upper_bound(chunk_starts.begin(), chunk_starts.end(), start.first, by_address), start);
+		}
+		T *at = chunks[count / ChunkSize]->data() + (count % ChunkSize);
+		new (at) T(std::forward< Args >(args)...);
+		count += 1;
+		generation += 1;
+		return *at;
+	}
+
+	//remove all elements:
+	void clear() {
+		for (size_t i = 0; i < count; ++i) {
+			(*this)[i].~T();
+		}
+		chunks.clear();
+		chunk_starts.clear();
+		count = 0;
+		generation += 1;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	//changes whenever elements are added or removed:
+	uint32_t generation = 0;
+
+	T &operator[](size_t i) {
+		assert(i < count);
+		return chunks[i / ChunkSize]->data()[i % ChunkSize];
+	}
+	T const &operator[](size_t i) const {
+		assert(i < count);
+		return chunks[i / ChunkSize]->data()[i % ChunkSize];
+	}
+
+	T &front() { return (*this)[0]; }
+	T const &front() const { return (*this)[0]; }
+	T &back() { return (*this)[count - 1]; }
+	T const &back() const { return (*this)[count - 1]; }
+
+	//index of the element at 'ptr', or -1U if 'ptr' isn't an element of this list:
+	// (O(log chunks) -- used to fix up pointers when copying)
+	uint32_t index_of(T const *ptr) const {
+		if (ptr == nullptr || chunk_starts.empty()) return -1U;
+		auto f = std::upper_bound(chunk_starts.begin(), chunk_starts.end(), ptr, by_address);
+		if (f == chunk_starts.begin()) return -1U;
+		--f;
+		if (!std::less< T const * >()(ptr, f->first + ChunkSize)) return -1U;
+		size_t index = size_t(f->second) * ChunkSize + size_t(ptr - f->first);
+		if (index >= count) return -1U;
+		return uint32_t(index);
+	}
+
+	template< typename L, typename V >
+	struct Iterator {
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = V *;
+		using reference = V &;
+
+		Iterator(L *list_, size_t index_) : list(list_), index(index_) { }
+		V &operator*() const { return (*list)[index]; }
+		V *operator->() const { return &(*list)[index]; }
+		Iterator &operator++() { ++index; return *this; }
+		Iterator operator++(int) { Iterator ret = *this; ++index; return ret; }
+		bool operator==(Iterator const &o) const { return index == o.index; }
+		bool operator!=(Iterator const &o) const { return index != o.index; }
+
+		L *list;
+		size_t index;
+	};
+	typedef Iterator< ChunkList, T > iterator;
+	typedef Iterator< ChunkList const, T const > const_iterator;
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, count); }
+	const_iterator begin() const { return const_iterator(this, 0); }
+	const_iterator end() const { return const_iterator(this, count); }
+
+	//-- internals --
+	struct Chunk {
+		alignas(T) unsigned char storage[ChunkSize * sizeof(T)];
+		T *data() { return reinterpret_cast< T * >(storage); }
+	};
+	std::vector< std::unique_ptr< Chunk > > chunks;
+	std::vector< std::pair< T const *, uint32_t > > chunk_starts; //(first element, chunk index), sorted by address
+	static bool by_address(T const *ptr, std::pair< T const *, uint32_t > const &start) {
+		return std::less< T const * >()(ptr, start.first);
+	}
+	size_t count = 0;
+};
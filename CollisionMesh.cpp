@@ -0,0 +1,325 @@
+#include "CollisionMesh.hpp"
+
+#include "collide.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+//helper: surface area of a box (zero if empty):
+static float box_area(glm::vec3 const &min, glm::vec3 const &max) {
+	glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+//helper: does start + t * direction pass through [min,max] for some t in [0,max_t]?
+// if so, sets *t to the entry time (handles zero direction components)
+static bool segment_hits_box(glm::vec3 const &start, glm::vec3 const &direction, float max_t, glm::vec3 const &min, glm::vec3 const &max, float *t) {
+	float t0 = 0.0f;
+	float t1 = max_t;
+	for (uint32_t c = 0; c < 3; ++c) {
+		if (direction[c] == 0.0f) {
+			if (start[c] < min[c] || start[c] > max[c]) return false;
+			continue;
+		}
+		float inv = 1.0f / direction[c];
+		float a = (min[c] - start[c]) * inv;
+		float b = (max[c] - start[c]) * inv;
+		if (a > b) std::swap(a, b);
+		t0 = std::max(t0, a);
+		t1 = std::min(t1, b);
+		if (t0 > t1) return false;
+	}
+	*t = t0;
+	return true;
+}
+
+CollisionMesh::CollisionMesh(std::vector< glm::vec3 > const &positions_, std::vector< uint32_t > const &corners) {
+	assert(corners.size() % 3 == 0);
+
+	//merge duplicate positions (vertices are often split by normals or texture coordinates):
+	std::vector< uint32_t > remap(positions_.size(), -1U);
+	{
+		auto less = [](glm::vec3 const &a, glm::vec3 const &b) {
+			return std::memcmp(&a, &b, sizeof(glm::vec3)) < 0;
+		};
+		std::map< glm::vec3, uint32_t, decltype(less) > unique(less);
+		for (uint32_t c : corners) {
+			assert(c < positions_.size());
+			if (remap[c] != -1U) continue;
+			auto f = unique.insert(std::make_pair(positions_[c], uint32_t(positions.size())));
+			if (f.second) positions.emplace_back(positions_[c]);
+			remap[c] = f.first->second;
+		}
+	}
+
+	std::vector< glm::uvec3 > input;
+	input.reserve(corners.size() / 3);
+	for (uint32_t i = 0; i + 2 < corners.size(); i += 3) {
+		glm::uvec3 tri(remap[corners[i+0]], remap[corners[i+1]], remap[corners[i+2]]);
+		if (tri.x == tri.y || tri.y == tri.z || tri.z == tri.x) continue;
+		input.emplace_back(tri);
+	}
+	if (input.empty()) return;
+
+	//triangle boxes and centroids (for building):
+	std::vector< glm::vec3 > tri_min, tri_max, centroid;
+	tri_min.reserve(input.size());
+	tri_max.reserve(input.size());
+	centroid.reserve(input.size());
+	for (auto const &tri : input) {
+		glm::vec3 const &a = positions[tri.x];
+		glm::vec3 const &b = positions[tri.y];
+		glm::vec3 const &c = positions[tri.z];
+		tri_min.emplace_back(glm::min(a, glm::min(b, c)));
+		tri_max.emplace_back(glm::max(a, glm::max(b, c)));
+		centroid.emplace_back(0.5f * (tri_min.back() + tri_max.back()));
+	}
+
+	//order[] holds input triangle indices; each node covers a contiguous range of it:
+	std::vector< uint32_t > order(input.size());
+	for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+
+	nodes.reserve(2 * input.size());
+
+	//Build with a binned surface area heuristic:
+	// (cost of a split is TraversalCost + sum over children of area(child) / area(parent) * triangles(child))
+	enum : uint32_t { Bins = 16 };
+	float const TraversalCost = 1.0f;
+
+	struct Range { uint32_t begin, end, depth, parent; };
+	std::vector< Range > todo;
+	todo.emplace_back(Range{0, uint32_t(order.size()), 0, -1U});
+	while (!todo.empty()) {
+		Range range = todo.back();
+		todo.pop_back();
+
+		uint32_t index = uint32_t(nodes.size());
+		nodes.emplace_back();
+		if (range.parent != -1U) {
+			//(ranges are pushed right-then-left, so a range whose parent isn't the previous node is a right child)
+			if (range.parent + 1 != index) nodes[range.parent].index = index;
+		}
+
+		glm::vec3 node_min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 node_max = glm::vec3(-std::numeric_limits< float >::infinity());
+		glm::vec3 centroid_min = node_min;
+		glm::vec3 centroid_max = node_max;
+		for (uint32_t i = range.begin; i < range.end; ++i) {
+			node_min = glm::min(node_min, tri_min[order[i]]);
+			node_max = glm::max(node_max, tri_max[order[i]]);
+			centroid_min = glm::min(centroid_min, centroid[order[i]]);
+			centroid_max = glm::max(centroid_max, centroid[order[i]]);
+		}
+		nodes[index].min = node_min;
+		nodes[index].max = node_max;
+
+		uint32_t count = range.end - range.begin;
+
+		//find the best binned split:
+		float best_cost = std::numeric_limits< float >::infinity();
+		uint32_t best_axis = -1U;
+		uint32_t best_bin = 0;
+		float parent_area = box_area(node_min, node_max);
+		for (uint32_t axis = 0; axis < 3 && count > 1 && range.depth < MaxDepth; ++axis) {
+			float extent = centroid_max[axis] - centroid_min[axis];
+			if (!(extent > 0.0f)) continue;
+			float scale = Bins / extent;
+
+			uint32_t bin_count[Bins] = { 0 };
+			glm::vec3 bin_min[Bins], bin_max[Bins];
+			for (uint32_t b = 0; b < Bins; ++b) {
+				bin_min[b] = glm::vec3( std::numeric_limits< float >::infinity());
+				bin_max[b] = glm::vec3(-std::numeric_limits< float >::infinity());
+			}
+			for (uint32_t i = range.begin; i < range.end; ++i) {
+				uint32_t t = order[i];
+				uint32_t b = std::min(Bins - 1, uint32_t((centroid[t][axis] - centroid_min[axis]) * scale));
+				bin_count[b] += 1;
+				bin_min[b] = glm::min(bin_min[b], tri_min[t]);
+				bin_max[b] = glm::max(bin_max[b], tri_max[t]);
+			}
+
+			//sweep from the right to get the cost of everything right of each split:
+			float right_cost[Bins];
+			{
+				glm::vec3 r_min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 r_max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t r_count = 0;
+				for (uint32_t b = Bins - 1; b > 0; --b) {
+					r_min = glm::min(r_min, bin_min[b]);
+					r_max = glm::max(r_max, bin_max[b]);
+					r_count += bin_count[b];
+					right_cost[b] = box_area(r_min, r_max) * r_count;
+				}
+			}
+			//sweep from the left, combining with the right costs:
+			{
+				glm::vec3 l_min = glm::vec3( std::numeric_limits< float >::infinity());
+				glm::vec3 l_max = glm::vec3(-std::numeric_limits< float >::infinity());
+				uint32_t l_count = 0;
+				for (uint32_t b = 1; b < Bins; ++b) {
+					l_min = glm::min(l_min, bin_min[b-1]);
+					l_max = glm::max(l_max, bin_max[b-1]);
+					l_count += bin_count[b-1];
+					if (l_count == 0 || l_count == count) continue;
+					float cost = box_area(l_min, l_max) * l_count + right_cost[b];
+					if (cost < best_cost) {
+						best_cost = cost;
+						best_axis = axis;
+						best_bin = b;
+					}
+				}
+			}
+		}
+
+		bool split = false;
+		uint32_t mid = range.begin;
+		if (best_axis != -1U) {
+			float split_cost = TraversalCost + (parent_area > 0.0f ? best_cost / parent_area : 0.0f);
+			if (split_cost < float(count) || count > MaxLeafSize) {
+				uint32_t axis = best_axis;
+				float scale = Bins / (centroid_max[axis] - centroid_min[axis]);
+				auto in_left = [&](uint32_t t) {
+					return std::min(Bins - 1, uint32_t((centroid[t][axis] - centroid_min[axis]) * scale)) < best_bin;
+				};
+				mid = uint32_t(std::partition(order.begin() + range.begin, order.begin() + range.end, in_left) - order.begin());
+				split = true;
+			}
+		} else if (count > MaxLeafSize && range.depth < MaxDepth) {
+			//all centroids coincide; split in the middle to keep leaves small:
+			mid = range.begin + count / 2;
+			split = true;
+		}
+
+		if (split) {
+			assert(range.begin < mid && mid < range.end);
+			nodes[index].count = 0;
+			nodes[index].index = -1U; //(set when right child is created)
+			todo.emplace_back(Range{mid, range.end, range.depth + 1, index});
+			todo.emplace_back(Range{range.begin, mid, range.depth + 1, index});
+		} else {
+			nodes[index].index = range.begin;
+			nodes[index].count = count;
+		}
+	}
+
+	//store triangles in leaf order:
+	triangles.reserve(order.size());
+	for (uint32_t t : order) {
+		triangles.emplace_back(input[t]);
+	}
+	min = nodes[0].min;
+	max = nodes[0].max;
+}
+
+bool CollisionMesh::sweep_sphere(
+	glm::vec3 const &from, glm::vec3 const &to, float radius,
+	float *collision_t, glm::vec3 *collision_at, glm::vec3 *collision_out,
+	uint32_t *collision_triangle
+) const {
+	if (nodes.empty()) return false;
+
+	float t = (collision_t ? *collision_t : 1.0f);
+	bool collided = false;
+
+	glm::vec3 direction = to - from;
+	glm::vec3 r = glm::vec3(radius);
+
+	//traverse nearer children first, so later (farther) subtrees can be skipped once a hit is found:
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		float enter;
+		if (!segment_hits_box(from, direction, t, node.min - r, node.max + r, &enter)) continue;
+		if (node.count) {
+			//test leaf triangles a packet at a time:
+			// (leaves are at most MaxLeafSize triangles, except when the depth limit is hit)
+			for (uint32_t first = node.index; first < node.index + node.count; first += CollideTrianglePacket::Size) {
+				CollideTrianglePacket packet;
+				packet.count = std::min(uint32_t(CollideTrianglePacket::Size), node.index + node.count - first);
+				for (uint32_t i = 0; i < packet.count; ++i) {
+					glm::uvec3 const &tri = triangles[first + i];
+					packet.set(i, positions[tri.x], positions[tri.y], positions[tri.z]);
+				}
+				uint32_t hit = collide_swept_sphere_vs_triangles(from, to, radius, packet, &t, collision_at, collision_out);
+				if (hit != -1U) {
+					collided = true;
+					if (collision_triangle) *collision_triangle = first + hit;
+				}
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			Node const &left = nodes[index + 1];
+			Node const &right = nodes[node.index];
+			float t_left = std::numeric_limits< float >::infinity();
+			float t_right = std::numeric_limits< float >::infinity();
+			segment_hits_box(from, direction, t, left.min - r, left.max + r, &t_left);
+			segment_hits_box(from, direction, t, right.min - r, right.max + r, &t_right);
+			if (t_left <= t_right) {
+				stack[top++] = node.index;
+				stack[top++] = index + 1;
+			} else {
+				stack[top++] = index + 1;
+				stack[top++] = node.index;
+			}
+		}
+	}
+
+	if (collided && collision_t) *collision_t = t;
+	return collided;
+}
+
+bool CollisionMesh::ray(
+	glm::vec3 const &start, glm::vec3 const &direction,
+	float *collision_t, glm::vec3 *collision_at, glm::vec3 *collision_out,
+	uint32_t *collision_triangle
+) const {
+	if (nodes.empty()) return false;
+
+	float t = (collision_t ? *collision_t : std::numeric_limits< float >::infinity());
+	bool collided = false;
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		float enter;
+		if (!segment_hits_box(start, direction, t, node.min, node.max, &enter)) continue;
+		if (node.count) {
+			for (uint32_t i = node.index; i < node.index + node.count; ++i) {
+				if (collide_ray_vs_triangle(start, direction,
+					positions[triangles[i].x], positions[triangles[i].y], positions[triangles[i].z],
+					&t, collision_at, collision_out)) {
+					collided = true;
+					if (collision_triangle) *collision_triangle = i;
+				}
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			Node const &left = nodes[index + 1];
+			Node const &right = nodes[node.index];
+			float t_left = std::numeric_limits< float >::infinity();
+			float t_right = std::numeric_limits< float >::infinity();
+			segment_hits_box(start, direction, t, left.min, left.max, &t_left);
+			segment_hits_box(start, direction, t, right.min, right.max, &t_right);
+			if (t_left <= t_right) {
+				stack[top++] = node.index;
+				stack[top++] = index + 1;
+			} else {
+				stack[top++] = index + 1;
+				stack[top++] = node.index;
+			}
+		}
+	}
+
+	if (collided && collision_t) *collision_t = t;
+	return collided;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * A CollisionMesh is a compact, CPU-side copy of a mesh's triangles for
+ *  collision detection: deduplicated positions, triangles as index triples,
+ *  and a bounding volume hierarchy over the triangles so that queries only
+ *  run the (collide.hpp) narrow-phase tests on nearby triangles.
+ *
+ * The hierarchy is built with the surface area heuristic and stored in
+ *  depth-first order in 32-byte nodes; triangles are sorted so that each
+ *  leaf refers to a contiguous range of them.
+ *
+ * MeshBuffer builds these on demand (see MeshBuffer::lookup_collision), so
+ *  meshes that are only ever drawn don't keep any vertex data on the CPU.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct CollisionMesh {
+	//build from a triangle list:
+	// triangle i is positions[corners[3*i+0]], positions[corners[3*i+1]], positions[corners[3*i+2]]
+	// (duplicate positions are merged, degenerate triangles are dropped, and triangles are reordered)
+	CollisionMesh(std::vector< glm::vec3 > const &positions, std::vector< uint32_t > const &corners);
+
+	//find the first triangle hit by a sphere of 'radius' moving from 'from' to 'to':
+	// returns 'true' on collision; output parameters are as per collide_swept_sphere_vs_triangle
+	// (*collision_t, if given, limits the search to times before it; otherwise times up to 1.0 are considered)
+	bool sweep_sphere(
+		glm::vec3 const &from, glm::vec3 const &to, float radius,
+		float *collision_t = nullptr, glm::vec3 *collision_at = nullptr, glm::vec3 *collision_out = nullptr,
+		uint32_t *collision_triangle = nullptr //[optional,out] index of triangle hit
+	) const;
+
+	//find the first triangle hit by the ray start + t * direction (t >= 0):
+	// returns 'true' on collision; output parameters are as per collide_ray_vs_triangle
+	// (*collision_t, if given, limits the search to times before it)
+	bool ray(
+		glm::vec3 const &start, glm::vec3 const &direction,
+		float *collision_t = nullptr, glm::vec3 *collision_at = nullptr, glm::vec3 *collision_out = nullptr,
+		uint32_t *collision_triangle = nullptr //[optional,out] index of triangle hit
+	) const;
+
+	//call fn(triangle) for every triangle whose bounding box overlaps [min,max]:
+	template< typename F >
+	void query_box(glm::vec3 const &min, glm::vec3 const &max, F const &fn) const;
+
+	std::vector< glm::vec3 > positions;
+	std::vector< glm::uvec3 > triangles; //indices into positions
+
+	//bounding box of all triangles:
+	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//-- internals --
+
+	enum : uint32_t { MaxLeafSize = 8, MaxDepth = 64 };
+
+	//nodes are stored in depth-first order, so the left child of node i is always i+1:
+	struct Node {
+		glm::vec3 min;
+		uint32_t index; //interior nodes: index of right child; leaves: first triangle
+		glm::vec3 max;
+		uint32_t count; //number of triangles (zero for interior nodes)
+	};
+	static_assert(sizeof(Node) == 32, "Node is 32 bytes.");
+	std::vector< Node > nodes;
+};
+
+//------------------------------------------------------
+
+template< typename F >
+void CollisionMesh::query_box(glm::vec3 const &box_min, glm::vec3 const &box_max, F const &fn) const {
+	if (nodes.empty()) return;
+
+	auto overlaps = [&box_min, &box_max](glm::vec3 const &a_min, glm::vec3 const &a_max) {
+		return !(
+			   (a_max.x < box_min.x) || (a_max.y < box_min.y) || (a_max.z < box_min.z)
+			|| (box_max.x < a_min.x) || (box_max.y < a_min.y) || (box_max.z < a_min.z)
+		);
+	};
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top) {
+		uint32_t index = stack[--top];
+		Node const &node = nodes[index];
+		if (!overlaps(node.min, node.max)) continue;
+		if (node.count) {
+			for (uint32_t t = node.index; t < node.index + node.count; ++t) {
+				glm::vec3 const &a = positions[triangles[t].x];
+				glm::vec3 const &b = positions[triangles[t].y];
+				glm::vec3 const &c = positions[triangles[t].z];
+				if (overlaps(glm::min(a, glm::min(b, c)), glm::max(a, glm::max(b, c)))) fn(t);
+			}
+		} else {
+			assert(top + 2 <= MaxDepth + 1);
+			stack[top++] = node.index;
+			stack[top++] = index + 1;
+		}
+	}
+}
@@ -0,0 +1,332 @@
+#include "CollisionWorld.hpp"
+
+#include "collide.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+//helper: largest scale factor applied by the upper 3x3 of a transform:
+static float max_scale(glm::mat4x3 const &m) {
+	return std::sqrt(std::max(glm::dot(m[0], m[0]), std::max(glm::dot(m[1], m[1]), glm::dot(m[2], m[2]))));
+}
+
+//helper: closest points between segments [p0,p1] and [q0,q1]:
+// (after Ericson, "Real-Time Collision Detection", section 5.1.9)
+static void closest_points_on_segments(
+	glm::vec3 const &p0, glm::vec3 const &p1, glm::vec3 const &q0, glm::vec3 const &q1,
+	glm::vec3 *on_p, glm::vec3 *on_q) {
+	glm::vec3 d1 = p1 - p0;
+	glm::vec3 d2 = q1 - q0;
+	glm::vec3 r = p0 - q0;
+	float a = glm::dot(d1, d1);
+	float e = glm::dot(d2, d2);
+	float f = glm::dot(d2, r);
+
+	float s = 0.0f;
+	float t = 0.0f;
+	if (a == 0.0f && e == 0.0f) {
+		//both segments are points
+	} else if (a == 0.0f) {
+		t = glm::clamp(f / e, 0.0f, 1.0f);
+	} else {
+		float c = glm::dot(d1, r);
+		if (e == 0.0f) {
+			s = glm::clamp(-c / a, 0.0f, 1.0f);
+		} else {
+			float b = glm::dot(d1, d2);
+			float denom = a * e - b * b;
+			if (denom > 0.0f) s = glm::clamp((b * f - c * e) / denom, 0.0f, 1.0f);
+			t = (b * s + f) / e;
+			if (t < 0.0f) {
+				t = 0.0f;
+				s = glm::clamp(-c / a, 0.0f, 1.0f);
+			} else if (t > 1.0f) {
+				t = 1.0f;
+				s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+			}
+		}
+	}
+	*on_p = p0 + s * d1;
+	*on_q = q0 + t * d2;
+}
+
+uint32_t CollisionWorld::add_object(Object const &object) {
+	uint32_t id;
+	if (!free_ids.empty()) {
+		id = free_ids.back();
+		free_ids.pop_back();
+		objects[id] = object;
+	} else {
+		id = uint32_t(objects.size());
+		objects.emplace_back(object);
+	}
+	//(placed at the end for now; update() will sort them into place)
+	endpoints.emplace_back(Endpoint{ std::numeric_limits< float >::infinity(), id * 2 + 0 });
+	endpoints.emplace_back(Endpoint{ std::numeric_limits< float >::infinity(), id * 2 + 1 });
+	return id;
+}
+
+uint32_t CollisionWorld::add_sphere(Scene::Transform *transform, float radius, glm::vec3 const &center) {
+	assert(transform);
+	Object object;
+	object.shape = Sphere;
+	object.transform = transform;
+	object.local_a = object.local_b = center;
+	object.local_radius = radius;
+	return add_object(object);
+}
+
+uint32_t CollisionWorld::add_capsule(Scene::Transform *transform, glm::vec3 const &a, glm::vec3 const &b, float radius) {
+	assert(transform);
+	Object object;
+	object.shape = Capsule;
+	object.transform = transform;
+	object.local_a = a;
+	object.local_b = b;
+	object.local_radius = radius;
+	return add_object(object);
+}
+
+uint32_t CollisionWorld::add_mesh(Scene::Transform *transform, CollisionMesh const *mesh) {
+	assert(transform);
+	assert(mesh);
+	Object object;
+	object.shape = Mesh;
+	object.transform = transform;
+	object.mesh = mesh;
+	return add_object(object);
+}
+
+void CollisionWorld::remove(uint32_t id) {
+	assert(id < objects.size() && objects[id].shape != Free);
+	objects[id] = Object();
+	free_ids.emplace_back(id);
+	endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(), [id](Endpoint const &e) {
+		return e.id_and_end / 2 == id;
+	}), endpoints.end());
+	pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [id](Pair const &p) {
+		return p.a == id || p.b == id;
+	}), pairs.end());
+}
+
+void CollisionWorld::update() {
+	//read transforms and compute boxes:
+	for (auto &object : objects) {
+		if (object.shape == Free) continue;
+		glm::mat4x3 const &local_to_world = object.transform->get_local_to_world();
+		if (object.shape == Mesh) {
+			object.local_to_world = local_to_world;
+			object.world_to_local = object.transform->get_world_to_local();
+			object.scale = std::abs(object.transform->cache.uniform_scale);
+			if (object.scale == 0.0f) {
+				throw std::runtime_error("CollisionWorld: mesh instance on transform '" + object.transform->name + "' is not uniformly scaled.");
+			}
+			CollisionMesh const &mesh = *object.mesh;
+			if (mesh.triangles.empty()) {
+				//nothing to hit; park box out of the way:
+				object.min = object.max = glm::vec3(std::numeric_limits< float >::infinity());
+				continue;
+			}
+			object.min = glm::vec3( std::numeric_limits< float >::infinity());
+			object.max = glm::vec3(-std::numeric_limits< float >::infinity());
+			for (uint32_t corner = 0; corner < 8; ++corner) {
+				glm::vec3 local = glm::vec3(
+					(corner & 1 ? mesh.max.x : mesh.min.x),
+					(corner & 2 ? mesh.max.y : mesh.min.y),
+					(corner & 4 ? mesh.max.z : mesh.min.z)
+				);
+				glm::vec3 world = local_to_world * glm::vec4(local, 1.0f);
+				object.min = glm::min(object.min, world);
+				object.max = glm::max(object.max, world);
+			}
+		} else {
+			object.prev_a = object.a;
+			object.prev_b = object.b;
+			object.a = local_to_world * glm::vec4(object.local_a, 1.0f);
+			object.b = local_to_world * glm::vec4(object.local_b, 1.0f);
+			float scale = std::abs(object.transform->cache.uniform_scale);
+			if (scale == 0.0f) scale = max_scale(local_to_world);
+			object.radius = object.local_radius * scale;
+			if (!object.placed) {
+				object.prev_a = object.a;
+				object.prev_b = object.b;
+				object.placed = true;
+			}
+			glm::vec3 r = glm::vec3(object.radius);
+			object.min = glm::min(glm::min(object.prev_a, object.prev_b), glm::min(object.a, object.b)) - r;
+			object.max = glm::max(glm::max(object.prev_a, object.prev_b), glm::max(object.a, object.b)) + r;
+		}
+	}
+
+	//refresh and re-sort box ends:
+	for (auto &e : endpoints) {
+		Object const &object = objects[e.id_and_end / 2];
+		e.x = (e.id_and_end & 1 ? object.max.x : object.min.x);
+	}
+	//(mins sort before maxes at the same x, so touching boxes count as overlapping)
+	auto before = [](Endpoint const &a, Endpoint const &b) {
+		if (a.x != b.x) return a.x < b.x;
+		return (a.id_and_end & 1) < (b.id_and_end & 1);
+	};
+	//insertion sort -- ends are mostly in order from the previous update:
+	for (uint32_t i = 1; i < endpoints.size(); ++i) {
+		Endpoint e = endpoints[i];
+		uint32_t j = i;
+		while (j > 0 && before(e, endpoints[j-1])) {
+			endpoints[j] = endpoints[j-1];
+			--j;
+		}
+		endpoints[j] = e;
+	}
+
+	//sweep along x, checking y and z for objects whose x ranges overlap:
+	pairs.clear();
+	std::vector< uint32_t > active;
+	for (auto const &e : endpoints) {
+		uint32_t id = e.id_and_end / 2;
+		if (e.id_and_end & 1) {
+			auto f = std::find(active.begin(), active.end(), id);
+			assert(f != active.end());
+			*f = active.back();
+			active.pop_back();
+		} else {
+			Object const &object = objects[id];
+			for (uint32_t other_id : active) {
+				Object const &other = objects[other_id];
+				if (object.shape == Mesh && other.shape == Mesh) continue;
+				if (!collide_AABB_vs_AABB(object.min, object.max, other.min, other.max)) continue;
+				if (object.shape == Mesh) {
+					pairs.emplace_back(Pair{ other_id, id });
+				} else if (other.shape == Mesh) {
+					pairs.emplace_back(Pair{ id, other_id });
+				} else {
+					pairs.emplace_back(Pair{ std::min(id, other_id), std::max(id, other_id) });
+				}
+			}
+			active.emplace_back(id);
+		}
+	}
+	assert(active.empty());
+
+	//sort so results don't depend on the order of box ends:
+	std::sort(pairs.begin(), pairs.end(), [](Pair const &a, Pair const &b) {
+		if (a.a != b.a) return a.a < b.a;
+		return a.b < b.b;
+	});
+}
+
+bool CollisionWorld::collide(Pair const &pair, Contact *contact) const {
+	assert(contact);
+	Object const &a = objects[pair.a];
+	Object const &b = objects[pair.b];
+	assert(a.shape == Sphere || a.shape == Capsule);
+
+	//bodies move by the change in the middle of their segment:
+	// (so rotation during the step is not accounted for)
+	glm::vec3 a_motion = 0.5f * ((a.a + a.b) - (a.prev_a + a.prev_b));
+
+	if (b.shape == Mesh) {
+		//sweep spheres along the capsule through the mesh, in the mesh's local space:
+		// (spheres are at most one radius apart, so the capsule is covered to within ~0.13 radius)
+		float length = glm::length(a.prev_b - a.prev_a);
+		uint32_t steps = 1;
+		if (length > 0.0f) {
+			steps = (a.radius > 0.0f ? uint32_t(std::min(64.0f, std::ceil(length / a.radius))) : 1);
+			steps = std::max(1U, steps);
+		}
+		float radius = a.radius / b.scale;
+
+		float t = 1.0f;
+		glm::vec3 at, out;
+		uint32_t triangle = -1U;
+		bool collided = false;
+		for (uint32_t s = 0; s <= steps; ++s) {
+			if (length == 0.0f && s > 0) break;
+			glm::vec3 from = glm::mix(a.prev_a, a.prev_b, float(s) / float(steps));
+			glm::vec3 from_local = b.world_to_local * glm::vec4(from, 1.0f);
+			glm::vec3 to_local = b.world_to_local * glm::vec4(from + a_motion, 1.0f);
+			if (b.mesh->sweep_sphere(from_local, to_local, radius, &t, &at, &out, &triangle)) {
+				collided = true;
+			}
+		}
+		if (!collided) return false;
+
+		contact->a = pair.a;
+		contact->b = pair.b;
+		contact->t = t;
+		contact->at = b.local_to_world * glm::vec4(at, 1.0f);
+		contact->out = glm::normalize(glm::mat3(b.local_to_world) * out);
+		contact->triangle = triangle;
+		return true;
+	} else {
+		//body vs body:
+		// A and B touch when the origin is within (A.radius + B.radius) of A - B = { a - b },
+		// which is the parallelogram with corners (A.ends - B.ends); A - B moves by (A.motion - B.motion),
+		// so the origin (relative to the parallelogram) moves by (B.motion - A.motion):
+		glm::vec3 b_motion = 0.5f * ((b.a + b.b) - (b.prev_a + b.prev_b));
+		glm::vec3 c00 = a.prev_a - b.prev_a;
+		glm::vec3 c10 = a.prev_b - b.prev_a;
+		glm::vec3 c11 = a.prev_b - b.prev_b;
+		glm::vec3 c01 = a.prev_a - b.prev_b;
+		glm::vec3 from = glm::vec3(0.0f);
+		glm::vec3 to = b_motion - a_motion;
+		float radius = a.radius + b.radius;
+
+		float t = 1.0f;
+		glm::vec3 at, out;
+		bool collided = false;
+		if (collide_swept_sphere_vs_triangle(from, to, radius, c00, c10, c11, &t, &at, &out)) collided = true;
+		if (collide_swept_sphere_vs_triangle(from, to, radius, c00, c11, c01, &t, &at, &out)) collided = true;
+		if (!collided) return false;
+
+		//moving the origin along 'out' is moving A - B (so A) along -out:
+		contact->a = pair.a;
+		contact->b = pair.b;
+		contact->t = t;
+		contact->out = -out;
+		contact->triangle = -1U;
+
+		//contact point from closest points between the segments at time t:
+		glm::vec3 on_a, on_b;
+		closest_points_on_segments(
+			a.prev_a + t * a_motion, a.prev_b + t * a_motion,
+			b.prev_a + t * b_motion, b.prev_b + t * b_motion,
+			&on_a, &on_b);
+		contact->at = on_a + out * a.radius;
+		return true;
+	}
+}
+
+void CollisionWorld::collide(std::vector< Contact > *contacts, WorkerPool *pool) const {
+	assert(contacts);
+	if (!pool || pool->size() == 1) {
+		for (auto const &pair : pairs) {
+			Contact contact;
+			if (collide(pair, &contact)) contacts->emplace_back(contact);
+		}
+		return;
+	}
+
+	//each pair writes to its own slot, so threads never share output:
+	pair_contacts.resize(pairs.size());
+	pair_touches.assign(pairs.size(), 0);
+
+	//jobs are runs of pairs, small enough to balance load, large enough to amortize handing them out:
+	uint32_t const PairsPerJob = 64;
+	uint32_t jobs = (uint32_t(pairs.size()) + PairsPerJob - 1) / PairsPerJob;
+	pool->run(jobs, [this](uint32_t job) {
+		uint32_t begin = job * PairsPerJob;
+		uint32_t end = std::min(uint32_t(pairs.size()), begin + PairsPerJob);
+		for (uint32_t i = begin; i < end; ++i) {
+			pair_touches[i] = collide(pairs[i], &pair_contacts[i]);
+		}
+	});
+
+	//gather in pair order:
+	for (uint32_t i = 0; i < pairs.size(); ++i) {
+		if (pair_touches[i]) contacts->emplace_back(pair_contacts[i]);
+	}
+}
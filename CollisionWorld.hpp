@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * A CollisionWorld keeps track of moving bodies (spheres and capsules) and
+ *  static mesh instances, each attached to a Scene::Transform, and finds
+ *  which of them touch as they move.
+ *
+ * Each update():
+ *  - reads every object's transform, and computes a box around where it
+ *    was at the previous update and where it is now;
+ *  - keeps the ends of those boxes sorted along x (insertion sort, which is
+ *    close to linear when objects move a little each frame);
+ *  - sweeps over the sorted ends to find pairs whose boxes overlap
+ *    ("sweep and prune"), skipping mesh-vs-mesh pairs.
+ *
+ * collide() runs the narrow-phase tests from collide.hpp on those pairs,
+ *  treating each body as moving in a straight line from its previous
+ *  position to its current one. The tests don't share any state, so they
+ *  can be spread over a WorkerPool; contacts are still reported in pair
+ *  order, so results don't depend on the number of threads.
+ *
+ */
+
+#include "Scene.hpp"
+#include "CollisionMesh.hpp"
+#include "WorkerPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct CollisionWorld {
+	//add objects; returned ids stay valid until the object is removed:
+	// (spheres and capsule ends are given in the transform's local space)
+	uint32_t add_sphere(Scene::Transform *transform, float radius, glm::vec3 const &center = glm::vec3(0.0f));
+	uint32_t add_capsule(Scene::Transform *transform, glm::vec3 const &a, glm::vec3 const &b, float radius);
+	//(mesh instances must not be non-uniformly scaled; the mesh must outlive the world)
+	uint32_t add_mesh(Scene::Transform *transform, CollisionMesh const *mesh);
+
+	void remove(uint32_t id);
+
+	//read transforms and find candidate pairs:
+	void update();
+
+	//pairs of objects whose (swept) boxes overlapped at the last update():
+	// (a < b, sorted; 'b' is the mesh in body-vs-mesh pairs)
+	struct Pair {
+		uint32_t a, b;
+	};
+	std::vector< Pair > pairs;
+
+	//first time each candidate pair touches during the last update's motion:
+	struct Contact {
+		uint32_t a, b; //as in 'pairs'
+		float t; //fraction of the motion (0 = previous positions, 1 = current positions)
+		glm::vec3 at; //world-space point of contact
+		glm::vec3 out; //direction to move 'a' to get away from 'b'
+		uint32_t triangle; //triangle of mesh 'b' (-1U for body-vs-body contacts)
+	};
+	//run narrow phase on 'pairs', appending a contact for every pair that touches:
+	// (contacts are appended in the same order as 'pairs')
+	// if 'pool' is given, pairs are split across its threads; results are identical either way
+	void collide(std::vector< Contact > *contacts, WorkerPool *pool = nullptr) const;
+
+	//run narrow phase on a single pair; returns 'true' and fills *contact if it touches:
+	bool collide(Pair const &pair, Contact *contact) const;
+
+	//-- internals --
+
+	enum Shape : uint8_t {
+		Free, //removed object, id can be re-used
+		Sphere, //(stored as a capsule with both ends the same)
+		Capsule,
+		Mesh,
+	};
+
+	struct Object {
+		Shape shape = Free;
+		Scene::Transform *transform = nullptr;
+
+		//bodies -- capsule ends and radius in local space:
+		glm::vec3 local_a = glm::vec3(0.0f), local_b = glm::vec3(0.0f);
+		float local_radius = 0.0f;
+		// ...and in world space, at the previous and current update:
+		glm::vec3 prev_a = glm::vec3(0.0f), prev_b = glm::vec3(0.0f);
+		glm::vec3 a = glm::vec3(0.0f), b = glm::vec3(0.0f);
+		float radius = 0.0f;
+		bool placed = false; //has been positioned by update() at least once
+
+		//meshes:
+		CollisionMesh const *mesh = nullptr;
+		glm::mat4x3 local_to_world = glm::mat4x3(1.0f);
+		glm::mat4x3 world_to_local = glm::mat4x3(1.0f);
+		float scale = 1.0f;
+
+		//world-space box covering previous and current positions:
+		glm::vec3 min = glm::vec3(0.0f), max = glm::vec3(0.0f);
+	};
+	std::vector< Object > objects;
+	std::vector< uint32_t > free_ids;
+
+	//sorted box ends along x:
+	struct Endpoint {
+		float x;
+		uint32_t id_and_end; //id * 2 + (0 for min, 1 for max)
+	};
+	std::vector< Endpoint > endpoints;
+
+	uint32_t add_object(Object const &object);
+
+	//scratch for parallel collide():
+	mutable std::vector< Contact > pair_contacts;
+	mutable std::vector< uint8_t > pair_touches;
+};
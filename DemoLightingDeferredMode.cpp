@@ -28,9 +28,7 @@ Load< Scene > spheres_scene_deferred(LoadTagLate, []() -> Scene const * {
 		Scene::Drawable::Pipeline &pipeline = scene.drawables.back().pipeline;
 		pipeline = basic_material_deferred_object_program_pipeline;
 		pipeline.vao = spheres_for_basic_material_deferred_object;
-		pipeline.type = mesh.type;
-		pipeline.start = mesh.start;
-		pipeline.count = mesh.count;
+		scene.drawables.back().set_mesh(mesh);
 
 		float roughness = 1.0f;
 		if (transform->name.substr(0, 9) == "Icosphere") {
@@ -4,6 +4,7 @@
 #include "data_path.hpp"
 #include "demo_menu.hpp"
 #include "BasicMaterialProgram.hpp"
+#include "UniformBlocks.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -25,9 +26,7 @@ Load< Scene > spheres_scene_multipass(LoadTagLate, []() -> Scene const * {
 		Scene::Drawable::Pipeline &pipeline = scene.drawables.back().pipeline;
 		pipeline = basic_material_program_pipeline;
 		pipeline.vao = spheres_for_basic_material;
-		pipeline.type = mesh.type;
-		pipeline.start = mesh.start;
-		pipeline.count = mesh.count;
+		scene.drawables.back().set_mesh(mesh);
 
 		float roughness = 1.0f;
 		if (transform->name.substr(0, 9) == "Icosphere") {
@@ -137,27 +136,15 @@ void DemoLightingMultipassMode::draw(glm::uvec2 const &drawable_size) {
 	glm::vec3 eye = scene_camera->transform->make_local_to_world()[3];
 	glm::mat4 world_to_clip = scene_camera->make_projection() * scene_camera->transform->make_world_to_local();
 
+	FrameBlock frame;
+	frame.world_to_clip = world_to_clip;
+	frame.eye = eye;
+	frame.lights = 1;
+
 	for (auto const &light : spheres_scene_multipass->lights) {
-		glm::mat4 light_to_world = light.transform->make_local_to_world();
 		//set up lighting information for this light:
-		glUseProgram(basic_material_program->program);
-		glUniform3fv(basic_material_program->EYE_vec3, 1, glm::value_ptr(eye));
-		glUniform3fv(basic_material_program->LIGHT_LOCATION_vec3, 1, glm::value_ptr(glm::vec3(light_to_world[3])));
-		glUniform3fv(basic_material_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(-light_to_world[2])));
-		glUniform3fv(basic_material_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(light.energy));
-		if (light.type == Scene::Light::Point) {
-			glUniform1i(basic_material_program->LIGHT_TYPE_int, 0);
-			glUniform1f(basic_material_program->LIGHT_CUTOFF_float, 1.0f);
-		} else if (light.type == Scene::Light::Hemisphere) {
-			glUniform1i(basic_material_program->LIGHT_TYPE_int, 1);
-			glUniform1f(basic_material_program->LIGHT_CUTOFF_float, 1.0f);
-		} else if (light.type == Scene::Light::Spot) {
-			glUniform1i(basic_material_program->LIGHT_TYPE_int, 2);
-			glUniform1f(basic_material_program->LIGHT_CUTOFF_float, std::cos(0.5f * light.spot_fov));
-		} else if (light.type == Scene::Light::Directional) {
-			glUniform1i(basic_material_program->LIGHT_TYPE_int, 3);
-			glUniform1f(basic_material_program->LIGHT_CUTOFF_float, 1.0f);
-		}
+		frame.set_light(0, light);
+		set_frame_block(frame);
 		spheres_scene_multipass->draw(world_to_clip);
 
 		glEnable(GL_BLEND);
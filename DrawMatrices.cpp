@@ -0,0 +1,98 @@
+#include "DrawMatrices.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define DRAW_MATRICES_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#ifdef DRAW_MATRICES_SSE
+
+//columns of a matrix with (up to) four rows, held in registers:
+struct Columns4 {
+	__m128 c[4];
+};
+
+//load a column of three floats (padding with zero):
+static inline __m128 load3(float const *v) {
+	return _mm_set_ps(0.0f, v[2], v[1], v[0]);
+}
+
+//store the first three floats of a register:
+static inline void store3(float *v, __m128 x) {
+	alignas(16) float tmp[4];
+	_mm_store_ps(tmp, x);
+	std::memcpy(v, tmp, 3 * sizeof(float));
+}
+
+//a * (x,y,z,w) for a matrix 'a' held by columns:
+static inline __m128 mul(Columns4 const &a, float x, float y, float z) {
+	__m128 r = _mm_mul_ps(a.c[0], _mm_set1_ps(x));
+	r = _mm_add_ps(r, _mm_mul_ps(a.c[1], _mm_set1_ps(y)));
+	r = _mm_add_ps(r, _mm_mul_ps(a.c[2], _mm_set1_ps(z)));
+	return r;
+}
+
+void compute_draw_matrices(
+	glm::mat4 const &world_to_clip,
+	glm::mat4x3 const &world_to_light,
+	glm::mat3 const &normal_world_to_light,
+	size_t count,
+	glm::mat4x3 const * const *object_to_world,
+	glm::mat3 const * const *normal_to_world,
+	DrawMatrices *out) {
+
+	assert(count == 0 || (object_to_world && normal_to_world && out));
+
+	//the (shared) world-space matrices are loaded once:
+	Columns4 clip, light, normal;
+	for (uint32_t c = 0; c < 4; ++c) {
+		clip.c[c] = _mm_loadu_ps(&world_to_clip[c][0]);
+		light.c[c] = load3(&world_to_light[c][0]);
+	}
+	for (uint32_t c = 0; c < 3; ++c) {
+		normal.c[c] = load3(&normal_world_to_light[c][0]);
+	}
+	normal.c[3] = _mm_setzero_ps();
+
+	for (size_t i = 0; i < count; ++i) {
+		glm::mat4x3 const &m = *object_to_world[i];
+		glm::mat3 const &n = *normal_to_world[i];
+		DrawMatrices &o = out[i];
+
+		//object_to_world has an implicit (0,0,0,1) bottom row:
+		for (uint32_t c = 0; c < 3; ++c) {
+			_mm_storeu_ps(&o.object_to_clip[c][0], mul(clip, m[c].x, m[c].y, m[c].z));
+			store3(&o.object_to_light[c][0], mul(light, m[c].x, m[c].y, m[c].z));
+			store3(&o.normal_to_light[c][0], mul(normal, n[c].x, n[c].y, n[c].z));
+		}
+		_mm_storeu_ps(&o.object_to_clip[3][0], _mm_add_ps(mul(clip, m[3].x, m[3].y, m[3].z), clip.c[3]));
+		store3(&o.object_to_light[3][0], _mm_add_ps(mul(light, m[3].x, m[3].y, m[3].z), light.c[3]));
+	}
+}
+
+#else //scalar fallback
+
+void compute_draw_matrices(
+	glm::mat4 const &world_to_clip,
+	glm::mat4x3 const &world_to_light,
+	glm::mat3 const &normal_world_to_light,
+	size_t count,
+	glm::mat4x3 const * const *object_to_world,
+	glm::mat3 const * const *normal_to_world,
+	DrawMatrices *out) {
+
+	assert(count == 0 || (object_to_world && normal_to_world && out));
+
+	for (size_t i = 0; i < count; ++i) {
+		glm::mat4 m = glm::mat4(*object_to_world[i]);
+		out[i].object_to_clip = world_to_clip * m;
+		out[i].object_to_light = world_to_light * m;
+		out[i].normal_to_light = normal_world_to_light * *normal_to_world[i];
+	}
+}
+
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * Batched computation of the per-drawable matrices used by Scene::draw.
+ *
+ * compute_draw_matrices() handles every visible drawable in one pass over
+ *  contiguous output, using SSE where available (with a scalar fallback).
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+struct DrawMatrices {
+	glm::mat4 object_to_clip;
+	glm::mat4x3 object_to_light;
+	glm::mat3 normal_to_light;
+};
+
+//for each i < count:
+//  out[i].object_to_clip = world_to_clip * object_to_world[i]
+//  out[i].object_to_light = world_to_light * object_to_world[i]
+//  out[i].normal_to_light = normal_world_to_light * normal_to_world[i]
+// where normal_world_to_light is the inverse transpose of world_to_light's upper 3x3,
+// and normal_to_world[i] is the inverse transpose of object_to_world[i]'s upper 3x3 (e.g., Transform::Cache::normal_to_world)
+void compute_draw_matrices(
+	glm::mat4 const &world_to_clip,
+	glm::mat4x3 const &world_to_light,
+	glm::mat3 const &normal_world_to_light,
+	size_t count,
+	glm::mat4x3 const * const *object_to_world,
+	glm::mat3 const * const *normal_to_world,
+	DrawMatrices *out
+);
@@ -0,0 +1,85 @@
+#pragma once
+
+/*
+ * Lanes is a handful of floats operated on together, using whichever
+ *  instruction set is available at compile time (eight floats with AVX,
+ *  four with SSE, one otherwise; LaneCount says which).
+ *
+ * Loads and stores are unaligned. Comparisons produce a LaneMask, which
+ *  lanes_bits() turns into one bit per lane (lane 0 in the low bit).
+ *
+ * (Used by collide's triangle packets and by BoneAnimationBatch.)
+ *
+ */
+
+#if defined(__AVX__)
+#define LANES_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LANES_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+//(wrapped in a struct so that arithmetic operators can be defined on all compilers)
+#if defined(LANES_AVX)
+
+struct Lanes { __m256 v; };
+typedef __m256 LaneMask;
+static const uint32_t LaneCount = 8;
+inline Lanes lanes_set(float x) { return Lanes{_mm256_set1_ps(x)}; }
+inline Lanes lanes_load(float const *x) { return Lanes{_mm256_loadu_ps(x)}; }
+inline void lanes_store(float *x, Lanes a) { _mm256_storeu_ps(x, a.v); }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{_mm256_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{_mm256_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{_mm256_mul_ps(a.v, b.v)}; }
+inline Lanes lanes_min(Lanes a, Lanes b) { return Lanes{_mm256_min_ps(a.v, b.v)}; }
+inline Lanes lanes_max(Lanes a, Lanes b) { return Lanes{_mm256_max_ps(a.v, b.v)}; }
+inline Lanes lanes_abs(Lanes a) { return Lanes{_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+inline LaneMask lanes_lt(Lanes a, Lanes b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline LaneMask lanes_and(LaneMask a, LaneMask b) { return _mm256_and_ps(a, b); }
+inline LaneMask lanes_or(LaneMask a, LaneMask b) { return _mm256_or_ps(a, b); }
+inline uint32_t lanes_bits(LaneMask a) { return uint32_t(_mm256_movemask_ps(a)); }
+
+#elif defined(LANES_SSE)
+
+struct Lanes { __m128 v; };
+typedef __m128 LaneMask;
+static const uint32_t LaneCount = 4;
+inline Lanes lanes_set(float x) { return Lanes{_mm_set1_ps(x)}; }
+inline Lanes lanes_load(float const *x) { return Lanes{_mm_loadu_ps(x)}; }
+inline void lanes_store(float *x, Lanes a) { _mm_storeu_ps(x, a.v); }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{_mm_add_ps(a.v, b.v)}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{_mm_sub_ps(a.v, b.v)}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{_mm_mul_ps(a.v, b.v)}; }
+inline Lanes lanes_min(Lanes a, Lanes b) { return Lanes{_mm_min_ps(a.v, b.v)}; }
+inline Lanes lanes_max(Lanes a, Lanes b) { return Lanes{_mm_max_ps(a.v, b.v)}; }
+inline Lanes lanes_abs(Lanes a) { return Lanes{_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+inline LaneMask lanes_lt(Lanes a, Lanes b) { return _mm_cmplt_ps(a.v, b.v); }
+inline LaneMask lanes_and(LaneMask a, LaneMask b) { return _mm_and_ps(a, b); }
+inline LaneMask lanes_or(LaneMask a, LaneMask b) { return _mm_or_ps(a, b); }
+inline uint32_t lanes_bits(LaneMask a) { return uint32_t(_mm_movemask_ps(a)); }
+
+#else //scalar fallback
+
+struct Lanes { float v; };
+typedef bool LaneMask;
+static const uint32_t LaneCount = 1;
+inline Lanes lanes_set(float x) { return Lanes{x}; }
+inline Lanes lanes_load(float const *x) { return Lanes{*x}; }
+inline void lanes_store(float *x, Lanes a) { *x = a.v; }
+inline Lanes operator+(Lanes a, Lanes b) { return Lanes{a.v + b.v}; }
+inline Lanes operator-(Lanes a, Lanes b) { return Lanes{a.v - b.v}; }
+inline Lanes operator*(Lanes a, Lanes b) { return Lanes{a.v * b.v}; }
+inline Lanes lanes_min(Lanes a, Lanes b) { return Lanes{std::min(a.v, b.v)}; }
+inline Lanes lanes_max(Lanes a, Lanes b) { return Lanes{std::max(a.v, b.v)}; }
+inline Lanes lanes_abs(Lanes a) { return Lanes{std::abs(a.v)}; }
+inline LaneMask lanes_lt(Lanes a, Lanes b) { return a.v < b.v; }
+inline LaneMask lanes_and(LaneMask a, LaneMask b) { return a && b; }
+inline LaneMask lanes_or(LaneMask a, LaneMask b) { return a || b; }
+inline uint32_t lanes_bits(LaneMask a) { return a ? 1U : 0U; }
+
+#endif
@@ -1,5 +1,6 @@
 #include "LitColorTextureProgram.hpp"
 
+#include "UniformBlocks.hpp"
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
 
@@ -11,9 +12,11 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	//----- build the pipeline template -----
 	lit_color_texture_program_pipeline.program = ret->program;
 
-	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+	//object matrices are supplied via the "Object" uniform block:
+	lit_color_texture_program_pipeline.object_block = true;
+
+	lit_color_texture_program_pipeline.instanced.program = ret->instanced_program;
+	lit_color_texture_program_pipeline.instanced.INSTANCE_BASE_int = ret->instanced_INSTANCE_BASE_int;
 
 	//make a 1-pixel white texture to bind by default:
 	GLuint tex;
@@ -35,22 +38,44 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	return ret;
 });
 
+//fragment shader shared by the regular and instanced programs:
+static std::string const LitColorTextureFragmentShader =
+	"#version 330\n"
+	"uniform sampler2D TEX;\n"
+	"in vec3 position;\n"
+	"in vec3 normal;\n"
+	"in vec4 color;\n"
+	"in vec2 texCoord;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	vec3 n = normalize(normal);\n"
+	"	vec3 l = normalize(vec3(0.1, 0.1, 1.0));\n"
+	"	vec4 albedo = texture(TEX, texCoord) * color;\n"
+	//simple hemispherical lighting model:
+	"	vec3 light = mix(vec3(0.0,0.0,0.1), vec3(1.0,1.0,0.95), dot(n,l)*0.5+0.5);\n"
+	"	fragColor = vec4(light*albedo.rgb, albedo.a);\n"
+	"}\n"
+;
+
+//vertex attributes, with fixed locations so both programs can share vertex array objects:
+static std::string const LitColorTextureAttributes =
+	"layout(location=0) in vec4 Position;\n"
+	"layout(location=1) in vec3 Normal;\n"
+	"layout(location=2) in vec4 Color;\n"
+	"layout(location=3) in vec2 TexCoord;\n"
+	"out vec3 position;\n"
+	"out vec3 normal;\n"
+	"out vec4 color;\n"
+	"out vec2 texCoord;\n"
+;
+
 LitColorTextureProgram::LitColorTextureProgram() {
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
-		"uniform mat4 OBJECT_TO_CLIP;\n"
-		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
-		"uniform mat3 NORMAL_TO_LIGHT;\n"
-		"in vec4 Position;\n"
-		"in vec3 Normal;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
-		"out vec3 position;\n"
-		"out vec3 normal;\n"
-		"out vec4 color;\n"
-		"out vec2 texCoord;\n"
+		+ ObjectBlockGLSL
+		+ LitColorTextureAttributes +
 		"void main() {\n"
 		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
 		"	position = OBJECT_TO_LIGHT * Position;\n"
@@ -60,21 +85,7 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"}\n"
 	,
 		//fragment shader:
-		"#version 330\n"
-		"uniform sampler2D TEX;\n"
-		"in vec3 position;\n"
-		"in vec3 normal;\n"
-		"in vec4 color;\n"
-		"in vec2 texCoord;\n"
-		"out vec4 fragColor;\n"
-		"void main() {\n"
-		"	vec3 n = normalize(normal);\n"
-		"	vec3 l = normalize(vec3(0.1, 0.1, 1.0));\n"
-		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
-		//simple hemispherical lighting model:
-		"	vec3 light = mix(vec3(0.0,0.0,0.1), vec3(1.0,1.0,0.95), dot(n,l)*0.5+0.5);\n"
-		"	fragColor = vec4(light*albedo.rgb, albedo.a);\n"
-		"}\n"
+		LitColorTextureFragmentShader
 	);
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
@@ -86,9 +97,6 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
 
 	//look up the locations of uniforms:
-	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
-	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
-	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
 	//set TEX to always refer to texture binding zero:
@@ -97,10 +105,44 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+
+	//attach uniform blocks to their binding points:
+	bind_uniform_blocks(program);
+
+	//The instanced variant reads its matrices from Scene's per-instance buffer:
+	instanced_program = gl_compile_program(
+		//vertex shader:
+		"#version 330\n"
+		+ std::string(Scene::InstanceGLSL)
+		+ LitColorTextureAttributes +
+		"void main() {\n"
+		"	gl_Position = instance_OBJECT_TO_CLIP() * Position;\n"
+		"	position = instance_OBJECT_TO_LIGHT() * Position;\n"
+		"	normal = instance_NORMAL_TO_LIGHT() * Normal;\n"
+		"	color = Color;\n"
+		"	texCoord = TexCoord;\n"
+		"}\n"
+	,
+		//fragment shader:
+		LitColorTextureFragmentShader
+	);
+
+	instanced_INSTANCE_BASE_int = glGetUniformLocation(instanced_program, "INSTANCE_BASE");
+	GLuint instanced_INSTANCES_samplerBuffer = glGetUniformLocation(instanced_program, "INSTANCES");
+	GLuint instanced_TEX_sampler2D = glGetUniformLocation(instanced_program, "TEX");
+
+	glUseProgram(instanced_program);
+
+	glUniform1i(instanced_INSTANCES_samplerBuffer, Scene::InstanceTextureUnit);
+	glUniform1i(instanced_TEX_sampler2D, 0);
+
+	glUseProgram(0);
 }
 
 LitColorTextureProgram::~LitColorTextureProgram() {
 	glDeleteProgram(program);
 	program = 0;
+	glDeleteProgram(instanced_program);
+	instanced_program = 0;
 }
 
@@ -17,13 +17,15 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
-	//Uniform (per-invocation variable) locations:
-	GLuint OBJECT_TO_CLIP_mat4 = -1U;
-	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
-	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
+	//Uniform blocks (see UniformBlocks.hpp):
+	//  Object - object-to-clip, object-to-light, and normal-to-light matrices (set by Scene::draw)
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
+
+	//Instanced variant (same attribute locations; matrices come from Scene's per-instance buffer):
+	GLuint instanced_program = 0;
+	GLuint instanced_INSTANCE_BASE_int = -1U;
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
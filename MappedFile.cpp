@@ -0,0 +1,83 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	file_handle = file;
+	size = size_t(file_size.QuadPart);
+	if (size == 0) return;
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		CloseHandle(file);
+		file_handle = nullptr;
+		throw std::runtime_error("Failed to create mapping of '" + filename + "'.");
+	}
+	mapping_handle = mapping;
+
+	data = reinterpret_cast< char const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		mapping_handle = nullptr;
+		file_handle = nullptr;
+		throw std::runtime_error("Failed to map view of '" + filename + "'.");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle(mapping_handle);
+	if (file_handle) CloseHandle(file_handle);
+}
+
+#else //POSIX
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	size = size_t(st.st_size);
+	if (size != 0) {
+		void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		data = reinterpret_cast< char const * >(ptr);
+	}
+	//(mapping stays valid after the descriptor is closed)
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (data) munmap(const_cast< char * >(data), size);
+}
+
+#endif
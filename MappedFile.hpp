@@ -0,0 +1,31 @@
+#pragma once
+
+/*
+ * MappedFile maps a whole file (read-only) into memory.
+ *
+ * Loaders can use the contents in place instead of copying them through
+ *  an istream; pages are brought in by the OS as they are touched.
+ *
+ */
+
+#include <cstddef>
+#include <string>
+
+struct MappedFile {
+	//map 'filename'; throws on failure:
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	std::string filename;
+	char const *data = nullptr; //(nullptr if file is empty)
+	size_t size = 0;
+
+	//-- internals --
+	#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+	#endif
+};
@@ -4,61 +4,103 @@
 #include <glm/glm.hpp>
 
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <set>
 #include <cstddef>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
+//mesh file contents (as written by export-meshes.py or optimize-meshes):
+
+struct MeshFileVertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(MeshFileVertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+//quantized vertex format:
+struct MeshFileQuantizedVertex {
+	uint16_t Position[3]; //16-bit unsigned fraction of mesh bounding box
+	uint16_t Padding;
+	uint32_t Normal; //GL_INT_2_10_10_10_REV signed-normalized xyz (w unused)
+	glm::u8vec4 Color;
+	uint16_t TexCoord[2]; //half floats
+};
+static_assert(sizeof(MeshFileQuantizedVertex) == 3*2+2+4+4*1+2*2, "QuantizedVertex is packed.");
+
+struct MeshFileIndexEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(MeshFileIndexEntry) == 16, "Index entry should be packed");
+
+struct MeshFileBounds {
+	glm::vec3 min, max;
+};
+static_assert(sizeof(MeshFileBounds) == 2*3*4, "Bounds should be packed");
+
+struct MeshFileElementRange {
+	uint32_t index_begin, index_end;
+};
+static_assert(sizeof(MeshFileElementRange) == 8, "Element range should be packed");
+
+MeshBuffer::MeshBuffer(std::string const &filename_) : filename(filename_) {
 	glGenBuffers(1, &buffer);
 
-	std::ifstream file(filename, std::ios::binary);
+	//file contents are used in place (see ChunkReader in read_write_chunk.hpp):
+	ChunkReader file(filename);
 
 	GLuint total = 0;
 
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
+	ChunkSpan< MeshFileVertex > data;
+	ChunkSpan< MeshFileQuantizedVertex > quantized_data;
+	bool quantized = false;
 
 	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct" && file.peek() == "pnq0") {
+		quantized_data = file.read< MeshFileQuantizedVertex >("pnq0");
+		quantized = true;
+
+		//upload data:
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, quantized_data.size() * sizeof(MeshFileQuantizedVertex), quantized_data.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		total = GLuint(quantized_data.size()); //store total for later checks on index
+
+		//store attrib locations:
+		Position = Attrib(buffer, 3, GL_UNSIGNED_SHORT, Attrib::AsFloatFromFixedPoint, sizeof(MeshFileQuantizedVertex), offsetof(MeshFileQuantizedVertex, Position));
+		Normal = Attrib(buffer, 4, GL_INT_2_10_10_10_REV, Attrib::AsFloatFromFixedPoint, sizeof(MeshFileQuantizedVertex), offsetof(MeshFileQuantizedVertex, Normal));
+		Color = Attrib(buffer, 4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(MeshFileQuantizedVertex), offsetof(MeshFileQuantizedVertex, Color));
+		TexCoord = Attrib(buffer, 2, GL_HALF_FLOAT, Attrib::AsFloat, sizeof(MeshFileQuantizedVertex), offsetof(MeshFileQuantizedVertex, TexCoord));
+	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
+		data = file.read< MeshFileVertex >("pnct");
 
 		//upload data:
 		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(MeshFileVertex), data.data(), GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		total = GLuint(data.size()); //store total for later checks on index
 
 		//store attrib locations:
-		Position = Attrib(buffer, 3, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(buffer, 3, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(buffer, 4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(buffer, 2, GL_FLOAT, Attrib::AsFloat, sizeof(Vertex), offsetof(Vertex, TexCoord));
+		Position = Attrib(buffer, 3, GL_FLOAT, Attrib::AsFloat, sizeof(MeshFileVertex), offsetof(MeshFileVertex, Position));
+		Normal = Attrib(buffer, 3, GL_FLOAT, Attrib::AsFloat, sizeof(MeshFileVertex), offsetof(MeshFileVertex, Normal));
+		Color = Attrib(buffer, 4, GL_UNSIGNED_BYTE, Attrib::AsFloatFromFixedPoint, sizeof(MeshFileVertex), offsetof(MeshFileVertex, Color));
+		TexCoord = Attrib(buffer, 2, GL_FLOAT, Attrib::AsFloat, sizeof(MeshFileVertex), offsetof(MeshFileVertex, TexCoord));
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	ChunkSpan< char > strings = file.read< char >("str0");
 
-	{ //read index chunk, add to meshes:
-		struct IndexEntry {
-			uint32_t name_begin, name_end;
-			uint32_t vertex_begin, vertex_end;
-		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+	//meshes, in file order:
+	std::vector< std::pair< std::string, Mesh > > file_meshes;
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+	{ //read index chunk:
+		ChunkSpan< MeshFileIndexEntry > index = file.read< MeshFileIndexEntry >("idx0");
 
 		for (auto const &entry : index) {
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
@@ -67,30 +109,78 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+			std::string name(strings.begin() + entry.name_begin, strings.begin() + entry.name_end);
 			Mesh mesh;
 			mesh.type = GL_TRIANGLES;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
-			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end && !data.empty(); ++v) {
 				mesh.min = glm::min(mesh.min, data[v].Position);
 				mesh.max = glm::max(mesh.max, data[v].Position);
 			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			file_meshes.emplace_back(name, mesh);
+		}
+	}
+
+	//quantized files store the box each mesh's positions are relative to:
+	if (quantized) {
+		ChunkSpan< MeshFileBounds > bounds = file.read< MeshFileBounds >("bnd0");
+
+		if (bounds.size() != file_meshes.size()) {
+			throw std::runtime_error("bounds chunk does not match index chunk");
+		}
+
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			Mesh &mesh = file_meshes[i].second;
+			mesh.min = bounds[i].min;
+			mesh.max = bounds[i].max;
+			mesh.position_offset = bounds[i].min;
+			mesh.position_scale = bounds[i].max - bounds[i].min;
+		}
+	}
+
+	//(optional) element range and element chunks make the meshes indexed:
+	if (file.peek() == "elr0") {
+		ChunkSpan< MeshFileElementRange > ranges = file.read< MeshFileElementRange >("elr0");
+		ChunkSpan< uint32_t > elements = file.read< uint32_t >("ele0");
+
+		if (ranges.size() != file_meshes.size()) {
+			throw std::runtime_error("element range chunk does not match index chunk");
+		}
+
+		for (uint32_t i = 0; i < ranges.size(); ++i) {
+			MeshFileElementRange const &range = ranges[i];
+			Mesh &mesh = file_meshes[i].second;
+			if (!(range.index_begin <= range.index_end && range.index_end <= elements.size())) {
+				throw std::runtime_error("element range has out-of-range index begin/end");
 			}
+			//indices must stay within the mesh's vertex range (this is what glDrawRangeElements is told):
+			for (uint32_t e = range.index_begin; e < range.index_end; ++e) {
+				if (!(mesh.start <= elements[e] && elements[e] < mesh.start + mesh.count)) {
+					throw std::runtime_error("element refers to vertex outside of its mesh's vertex range");
+				}
+			}
+			mesh.index_start = range.index_begin;
+			mesh.index_count = range.index_end - range.index_begin;
 		}
+
+		//upload elements:
+		// (through the array buffer binding, since the element array binding belongs to whatever vao is bound)
+		glGenBuffers(1, &index_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, index_buffer);
+		glBufferData(GL_ARRAY_BUFFER, elements.size() * sizeof(uint32_t), elements.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+	for (auto const &name_mesh : file_meshes) {
+		bool inserted = meshes.insert(name_mesh).second;
+		if (!inserted) {
+			std::cerr << "WARNING: mesh name '" + name_mesh.first + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+		}
 	}
 
-	//store positions for collision detection use:
-	positions.reserve(data.size());
-	for (auto const &v : data) {
-		positions.emplace_back(v.Position);
+	if (!file.at_end()) {
+		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
 
 	/* //DEBUG:
@@ -112,6 +202,53 @@ const Mesh &MeshBuffer::lookup(std::string const &name) const {
 	return f->second;
 }
 
+CollisionMesh const &MeshBuffer::lookup_collision(std::string const &name) const {
+	auto f = collision_meshes.find(name);
+	if (f != collision_meshes.end()) return *f->second;
+
+	Mesh const &mesh = lookup(name);
+
+	//re-read (just) this mesh's positions and indices from the file:
+	ChunkReader file(filename);
+
+	std::vector< glm::vec3 > positions;
+	positions.reserve(mesh.count);
+	if (file.peek() == "pnq0") {
+		ChunkSpan< MeshFileQuantizedVertex > data = file.read< MeshFileQuantizedVertex >("pnq0");
+		for (uint32_t v = mesh.start; v < mesh.start + mesh.count; ++v) {
+			uint16_t const *q = data[v].Position;
+			positions.emplace_back(mesh.position_offset + mesh.position_scale * (glm::vec3(q[0], q[1], q[2]) / 65535.0f));
+		}
+	} else {
+		ChunkSpan< MeshFileVertex > data = file.read< MeshFileVertex >("pnct");
+		for (uint32_t v = mesh.start; v < mesh.start + mesh.count; ++v) {
+			positions.emplace_back(data[v].Position);
+		}
+	}
+
+	std::vector< uint32_t > corners;
+	if (mesh.index_count) {
+		file.read< char >("str0");
+		file.read< MeshFileIndexEntry >("idx0");
+		if (file.peek() == "bnd0") file.read< MeshFileBounds >("bnd0");
+		file.read< MeshFileElementRange >("elr0");
+		ChunkSpan< uint32_t > elements = file.read< uint32_t >("ele0");
+		corners.reserve(mesh.index_count);
+		for (uint32_t e = mesh.index_start; e < mesh.index_start + mesh.index_count; ++e) {
+			corners.emplace_back(elements[e] - mesh.start);
+		}
+	} else {
+		corners.reserve(mesh.count);
+		for (uint32_t v = 0; v < mesh.count; ++v) {
+			corners.emplace_back(v);
+		}
+	}
+
+	std::unique_ptr< CollisionMesh > &collision = collision_meshes[name];
+	collision.reset(new CollisionMesh(positions, corners));
+	return *collision;
+}
+
 GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	std::map< std::string, Attrib const * > attribs;
 
@@ -120,5 +257,16 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	attribs["Color"] = &Color;
 	attribs["TexCoord"] = &TexCoord;
 
-	return ::make_vao_for_program(attribs, program);
+	GLuint vao = ::make_vao_for_program(attribs, program);
+
+	//element array buffer binding is part of vao state:
+	if (index_buffer != 0) {
+		GLint old_vao = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &old_vao);
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		glBindVertexArray(old_vao);
+	}
+
+	return vao;
 }
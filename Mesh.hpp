@@ -7,13 +7,25 @@
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
  *  using the MeshBuffer::lookup() function.
  *
+ * Files that contain an element chunk are indexed: each mesh is then also a
+ *  range of (32-bit) indices in the MeshBuffer's element array buffer, and
+ *  its vertex range only bounds the vertices those indices refer to.
+ *
+ * Files may also store vertices in a quantized (20-byte) format, where each
+ *  mesh's positions are 16-bit fractions of its bounding box. Scene's
+ *  Drawable::set_mesh copies the mesh's position_offset and position_scale
+ *  into the pipeline so that Scene::draw can fold the dequantization into
+ *  the object matrices.
+ *
  */
 
+#include "CollisionMesh.hpp"
 #include "make_vao_for_program.hpp"
 #include "GL.hpp"
 
 #include <glm/glm.hpp>
 #include <map>
+#include <memory>
 #include <limits>
 #include <string>
 #include <vector>
@@ -26,6 +38,15 @@ struct Mesh {
 	GLuint start = 0; //index of first vertex
 	GLuint count = 0; //count of vertices
 
+	//if index_count is nonzero, mesh is drawn with glDrawRangeElements:
+	GLuint index_start = 0; //index of first element (in MeshBuffer::index_buffer)
+	GLuint index_count = 0; //count of elements
+
+	//object-space position is position_offset + position_scale * (Position attribute):
+	// (not the identity only if the MeshBuffer's vertices are quantized)
+	glm::vec3 position_offset = glm::vec3(0.0f);
+	glm::vec3 position_scale = glm::vec3(1.0f);
+
 	//Bounding box.
 	//useful for debug visualization and collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
@@ -40,6 +61,11 @@ struct MeshBuffer {
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
 	const Mesh &lookup(std::string const &name) const;
+
+	//look up collision data for a mesh by name:
+	// built (by re-reading the file) the first time it is requested, so buffers never used for collision don't pay for it
+	// note: will throw if mesh not found.
+	CollisionMesh const &lookup_collision(std::string const &name) const;
 	
 	//build a vertex array object that links this vbo to attributes to a program:
 	// note: will throw if program defines attributes not contained in this buffer
@@ -48,6 +74,10 @@ struct MeshBuffer {
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
 
+	//Element array buffer containing (GL_UNSIGNED_INT) indices, if the file was indexed:
+	// (make_vao_for_program attaches this to the vao)
+	GLuint index_buffer = 0;
+
 	//-- internals ---
 
 	//used by the lookup() function:
@@ -59,6 +89,9 @@ struct MeshBuffer {
 	Attrib Color;
 	Attrib TexCoord;
 
-	//local copy of vertex information: (for collision detection)
-	std::vector< glm::vec3 > positions;
+	//file the buffer was loaded from (collision data is read from it on demand):
+	std::string filename;
+
+	//used by the lookup_collision() function:
+	mutable std::map< std::string, std::unique_ptr< CollisionMesh > > collision_meshes;
 };
@@ -1,5 +1,6 @@
 #include "PlantMode.hpp"
 
+#include "DrawLines.hpp"
 #include "LitColorTextureProgram.hpp"
 #include "BoneLitColorTextureProgram.hpp"
 #include "Load.hpp"
@@ -51,8 +52,7 @@ PlantMode::PlantMode() {
 		Scene::Drawable::Pipeline tile_info;
 		tile_info = lit_color_texture_program_pipeline;
 		tile_info.vao = *plant_meshes_for_lit_color_texture_program;
-		tile_info.start = plant_tile->start;
-		tile_info.count = plant_tile->count;
+		tile_info.set_mesh(*plant_tile);
 
 		for (int32_t x = -5; x <= 5; ++x) {
 			for (int32_t y = -5; y <= 5; ++y) {
@@ -64,6 +64,8 @@ PlantMode::PlantMode() {
 				scene.drawables.emplace_back(transform);
 				Scene::Drawable *tile = &scene.drawables.back();
 				tile->pipeline = tile_info;
+				tile->bbox_min = plant_tile->min;
+				tile->bbox_max = plant_tile->max;
 			}
 		}
 	}
@@ -73,23 +75,24 @@ PlantMode::PlantMode() {
 		plant_info = bone_lit_color_texture_program_pipeline;
 
 		plant_info.vao = *plant_banims_for_bone_lit_color_texture_program;
-		plant_info.start = plant_banims->mesh.start;
-		plant_info.count = plant_banims->mesh.count;
+		plant_info.set_mesh(plant_banims->mesh);
+
+		//bones come from the batch's palette buffer, so all plants can share one instanced draw:
+		plant_info.textures[1].texture = plant_animation_batch.palette_texture;
+		plant_info.textures[1].target = GL_TEXTURE_BUFFER;
 
 		plant_animations.reserve(5);
 		for (int32_t x = -2; x <= 2; ++x) {
-			if (x != 0) {
-				plant_animations.emplace_back(*plant_banims, *plant_banim_wind, BoneAnimationPlayer::Once);
-				plant_animations.back().position = 1.0f;
-			} else {
-				plant_animations.emplace_back(*plant_banims, *plant_banim_walk, BoneAnimationPlayer::Loop, 0.0f);
+			plant_animations.emplace_back(*plant_banims, *plant_banim_wind, BoneAnimationPlayer::Once);
+			plant_animations.back().position = 1.0f;
+			if (x == 0) {
+				//the center plant's walk is a layer over its resting pose, blended in while it moves (see update):
+				plant_animations.back().layers.emplace_back(*plant_banim_walk, BoneAnimationPlayer::Loop, 0.0f);
+				plant_animations.back().layers.back().weight = 0.0f;
 			}
 
-			BoneAnimationPlayer *player = &plant_animations.back();
-		
-			plant_info.set_uniforms = [player](){
-				player->set_uniform(bone_lit_color_texture_program->BONES_mat4x3_array);
-			};
+			//(plant_animations won't be resized, so pointers to players stay valid)
+			uint32_t palette_base = plant_animation_batch.add(&plant_animations.back());
 
 			scene.transforms.emplace_back();
 			Scene::Transform *transform = &scene.transforms.back();
@@ -97,6 +100,7 @@ PlantMode::PlantMode() {
 			scene.drawables.emplace_back(transform);
 			Scene::Drawable *plant = &scene.drawables.back();
 			plant->pipeline = plant_info;
+			plant->instance_data = palette_base;
 
 			if (x == 0) this->plant = plant;
 		};
@@ -145,6 +149,12 @@ bool PlantMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size
 		backward = false;
 		return true;
 	}
+	if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_F6) {
+		//toggle hierarchical culling (compare with F4 timing):
+		scene.use_bvh = !scene.use_bvh;
+		std::cout << "Scene BVH culling " << (scene.use_bvh ? "enabled" : "disabled") << "." << std::endl;
+		return true;
+	}
 
 	if (evt.type == SDL_MOUSEBUTTONDOWN) {
 		if (!mouse_captured) {
@@ -179,8 +189,20 @@ void PlantMode::update(float elapsed) {
 		if (forward) step += elapsed * 4.0f;
 		if (backward) step -= elapsed * 4.0f;
 		plant->transform->position.y += step;
-		plant_animations[2].position += step / 1.88803f;
-		plant_animations[2].position -= std::floor(plant_animations[2].position);
+		if (step != 0.0f) {
+			scene.transform_moved(plant->transform);
+
+			//find the tile under the plant (picking uses the scene's BVH):
+			Scene::Drawable const *tile = scene.pick_ray(plant->transform->position + glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+			tile_under_plant = tile;
+		}
+
+		BoneAnimationPlayer::Layer &walk = plant_animations[2].layers[0];
+		walk.position += step / 1.88803f;
+		walk.position -= std::floor(walk.position);
+		//fade the walk in and out over a quarter second, so starting and stopping don't pop:
+		float fade = (step != 0.0f ? elapsed : -elapsed) / 0.25f;
+		walk.weight = glm::clamp(walk.weight + fade, 0.0f, 1.0f);
 	}
 
 	float ce = std::cos(camera_elevation);
@@ -210,6 +232,10 @@ void PlantMode::update(float elapsed) {
 	for (auto &anim : plant_animations) {
 		anim.update(elapsed);
 	}
+
+	//compute skinning palettes before drawing:
+	// (resting plants -- including the center one, while its walk is faded out -- share one evaluation)
+	plant_animation_batch.evaluate();
 }
 
 void PlantMode::draw(glm::uvec2 const &drawable_size) {
@@ -227,7 +253,26 @@ void PlantMode::draw(glm::uvec2 const &drawable_size) {
 	glEnable(GL_CULL_FACE);
 	glCullFace(GL_BACK);
 
+	//skinning palettes (computed in update) go to the GPU all at once:
+	plant_animation_batch.upload();
+
 	scene.draw(*camera);
 
+	{ //name of the tile under the plant, in the upper left corner:
+		glDisable(GL_DEPTH_TEST);
+		float aspect = drawable_size.x / float(drawable_size.y);
+		DrawLines draw_lines(glm::mat4(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		));
+		constexpr float H = 0.09f;
+		draw_lines.draw_text("Over " + (tile_under_plant ? "'" + tile_under_plant->transform->name + "'" : std::string("nothing")),
+			glm::vec3(-aspect + 0.1f * H, 1.0f - 1.1f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+	}
+
 	GL_ERRORS();
 }
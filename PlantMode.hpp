@@ -3,6 +3,7 @@
 #include "Mode.hpp"
 
 #include "BoneAnimation.hpp"
+#include "BoneAnimationBatch.hpp"
 #include "GL.hpp"
 #include "Scene.hpp"
 
@@ -30,12 +31,14 @@ struct PlantMode : public Mode {
 	//scene:
 	Scene scene;
 	Scene::Drawable *plant = nullptr;
+	Scene::Drawable const *tile_under_plant = nullptr; //(found with Scene::pick_ray as the plant moves)
 	Scene::Camera *camera = nullptr;
 	float camera_radius = 10.0f;
 	float camera_azimuth = glm::radians(60.0f);
 	float camera_elevation = glm::radians(45.0f);
 
 	std::vector< BoneAnimationPlayer > plant_animations;
+	BoneAnimationBatch plant_animation_batch; //(evaluates and uploads plant_animations' palettes)
 
 	float wind_acc = 0.0f;
 };
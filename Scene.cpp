@@ -1,11 +1,15 @@
 #include "Scene.hpp"
 
+#include "DrawMatrices.hpp"
+#include "Mesh.hpp"
+#include "UniformBlocks.hpp"
 #include "gl_errors.hpp"
 #include "read_write_chunk.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
 
 //-------------------------
 
@@ -46,18 +50,125 @@ glm::mat4 Scene::Transform::make_parent_to_local() const {
 }
 
 glm::mat4 Scene::Transform::make_local_to_world() const {
-	if (!parent) {
-		return make_local_to_parent();
-	} else {
-		return parent->make_local_to_world() * make_local_to_parent();
-	}
+	return glm::mat4(get_local_to_world());
 }
 glm::mat4 Scene::Transform::make_world_to_local() const {
-	if (!parent) {
-		return make_parent_to_local();
-	} else {
-		return make_parent_to_local() * parent->make_world_to_local();
+	return glm::mat4(get_world_to_local());
+}
+
+glm::mat4x3 const &Scene::Transform::get_local_to_world() const {
+	update_cache();
+	return cache.local_to_world;
+}
+glm::mat4x3 const &Scene::Transform::get_world_to_local() const {
+	update_cache();
+	return cache.world_to_local;
+}
+
+void Scene::Transform::update_cache(uint32_t pass) const {
+	//already checked during this pass:
+	if (pass != 0 && cache.pass == pass) return;
+
+	//parent's matrices must be current before ours can be:
+	if (parent) parent->update_cache(pass);
+
+	bool dirty = !cache.valid
+		|| cache.position != position
+		|| cache.rotation != rotation
+		|| cache.scale != scale
+		|| cache.parent != parent
+		|| (parent && cache.parent_version != parent->cache.version);
+
+	if (dirty) {
+		//local-to-parent, built directly as an affine matrix:
+		glm::mat3 r = glm::mat3_cast(rotation);
+		glm::mat4x3 local_to_parent = glm::mat4x3(
+			r[0] * scale.x,
+			r[1] * scale.y,
+			r[2] * scale.z,
+			position
+		);
+
+		//parent-to-local is the inverse of the above:
+		glm::vec3 inv_scale;
+		inv_scale.x = (scale.x == 0.0f ? 0.0f : 1.0f / scale.x);
+		inv_scale.y = (scale.y == 0.0f ? 0.0f : 1.0f / scale.y);
+		inv_scale.z = (scale.z == 0.0f ? 0.0f : 1.0f / scale.z);
+		glm::mat3 rt = glm::transpose(r);
+		glm::mat3 srt = glm::mat3(
+			rt[0] * inv_scale,
+			rt[1] * inv_scale,
+			rt[2] * inv_scale
+		);
+		glm::mat4x3 parent_to_local = glm::mat4x3(
+			srt[0], srt[1], srt[2],
+			srt * -position
+		);
+
+		if (parent) {
+			cache.local_to_world = parent->cache.local_to_world * glm::mat4(local_to_parent);
+			cache.world_to_local = parent_to_local * glm::mat4(parent->cache.world_to_local);
+			cache.parent_version = parent->cache.version;
+		} else {
+			cache.local_to_world = local_to_parent;
+			cache.world_to_local = parent_to_local;
+			cache.parent_version = 0;
+		}
+
+		//normal matrix:
+		float local_uniform_scale = (scale.x == scale.y && scale.y == scale.z ? scale.x : 0.0f);
+		cache.uniform_scale = local_uniform_scale * (parent ? parent->cache.uniform_scale : 1.0f);
+		if (cache.uniform_scale != 0.0f) {
+			//fast path -- rotation * s has inverse transpose rotation / s:
+			cache.normal_to_world = glm::mat3(cache.local_to_world) * (1.0f / (cache.uniform_scale * cache.uniform_scale));
+		} else {
+			//general case -- the inverse is already available as world_to_local:
+			cache.normal_to_world = glm::transpose(glm::mat3(cache.world_to_local));
+		}
+
+		cache.valid = true;
+		cache.position = position;
+		cache.rotation = rotation;
+		cache.scale = scale;
+		cache.parent = parent;
+		cache.version += 1;
 	}
+
+	cache.pass = pass;
+}
+
+//each update pass gets a new (non-zero) id, so transforms shared between
+// drawables (or reached through several children) are only checked once per pass:
+static uint32_t next_update_pass() {
+	static uint32_t pass = 0;
+	pass += 1;
+	if (pass == 0) pass += 1;
+	return pass;
+}
+
+void Scene::update_world_matrices() const {
+	uint32_t pass = next_update_pass();
+	for (auto const &transform : transforms) {
+		transform.update_cache(pass);
+	}
+}
+
+//-------------------------
+
+void Scene::Drawable::Pipeline::set_mesh(Mesh const &mesh) {
+	type = mesh.type;
+	start = mesh.start;
+	count = mesh.count;
+	index_start = mesh.index_start;
+	index_count = mesh.index_count;
+	position_offset = mesh.position_offset;
+	position_scale = mesh.position_scale;
+}
+
+void Scene::Drawable::set_mesh(Mesh const &mesh) {
+	pipeline.set_mesh(mesh);
+	bbox_min = mesh.min;
+	bbox_max = mesh.max;
 }
 
 //-------------------------
@@ -68,6 +179,383 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 //-------------------------
 
+//helper: does the box [min,max] have finite extent? (drawables with infinite bounds are never culled)
+static bool box_is_finite(glm::vec3 const &min, glm::vec3 const &max) {
+	return std::isfinite(min.x) && std::isfinite(min.y) && std::isfinite(min.z)
+	    && std::isfinite(max.x) && std::isfinite(max.y) && std::isfinite(max.z);
+}
+
+//helper: extract the view frustum planes from a matrix that takes points to clip space:
+// (planes are in the space the matrix takes points *from*; a*x + b*y + c*z + d >= 0 is inside)
+static void frustum_planes(glm::mat4 const &to_clip, glm::vec4 planes[6]) {
+	//rows of the matrix:
+	glm::vec4 x = glm::vec4(to_clip[0][0], to_clip[1][0], to_clip[2][0], to_clip[3][0]);
+	glm::vec4 y = glm::vec4(to_clip[0][1], to_clip[1][1], to_clip[2][1], to_clip[3][1]);
+	glm::vec4 z = glm::vec4(to_clip[0][2], to_clip[1][2], to_clip[2][2], to_clip[3][2]);
+	glm::vec4 w = glm::vec4(to_clip[0][3], to_clip[1][3], to_clip[2][3], to_clip[3][3]);
+
+	//clip-space frustum is -w <= x,y,z <= w:
+	planes[0] = w + x;
+	planes[1] = w - x;
+	planes[2] = w + y;
+	planes[3] = w - y;
+	planes[4] = w + z;
+	planes[5] = w - z;
+}
+
+//helper: is the box [min,max] (in object space) entirely outside the view frustum?
+static bool box_outside_frustum(glm::mat4 const &object_to_clip, glm::vec3 const &min, glm::vec3 const &max) {
+	glm::vec3 center = 0.5f * (max + min);
+	glm::vec3 radius = 0.5f * (max - min);
+
+	glm::vec4 planes[6];
+	frustum_planes(object_to_clip, planes);
+
+	for (auto const &p : planes) {
+		//signed distance (scaled) of the box center and the box's extent along the plane normal:
+		float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+		float r = std::abs(p.x) * radius.x + std::abs(p.y) * radius.y + std::abs(p.z) * radius.z;
+		if (d + r < 0.0f) return true;
+	}
+	return false;
+}
+
+//helper: world-space box around a drawable's (object-space) bounding box:
+static void drawable_world_box(Scene::Drawable const &drawable, glm::vec3 *min, glm::vec3 *max) {
+	glm::mat4x3 const &object_to_world = drawable.transform->cache.local_to_world;
+	glm::vec3 center = 0.5f * (drawable.bbox_max + drawable.bbox_min);
+	glm::vec3 radius = 0.5f * (drawable.bbox_max - drawable.bbox_min);
+	glm::vec3 world_center = object_to_world * glm::vec4(center, 1.0f);
+	glm::vec3 world_radius =
+		  glm::abs(object_to_world[0]) * radius.x
+		+ glm::abs(object_to_world[1]) * radius.y
+		+ glm::abs(object_to_world[2]) * radius.z;
+	*min = world_center - world_radius;
+	*max = world_center + world_radius;
+}
+
+//helper: group values [0, keys.size()) by key (-1U keys are left out), CSR-style:
+// values with key k end up in values[start[k]] .. values[start[k+1]-1], in increasing order
+static void group_by_key(std::vector< uint32_t > const &keys, uint32_t key_count, std::vector< uint32_t > *start_, std::vector< uint32_t > *values_) {
+	assert(start_);
+	auto &start = *start_;
+	assert(values_);
+	auto &values = *values_;
+
+	start.assign(key_count + 1, 0);
+	for (uint32_t key : keys) {
+		if (key != -1U) start[key + 1] += 1;
+	}
+	for (uint32_t k = 0; k < key_count; ++k) {
+		start[k + 1] += start[k];
+	}
+	values.resize(start[key_count]);
+	std::vector< uint32_t > next(start.begin(), start.end() - 1);
+	for (uint32_t v = 0; v < keys.size(); ++v) {
+		if (keys[v] != -1U) values[next[keys[v]]++] = v;
+	}
+}
+
+void Scene::transform_moved(Transform const *transform) {
+	DrawableBVH &state = drawable_bvh;
+	//(until the first update, there is nothing to refit)
+	if (!state.built) return;
+	uint32_t index = transforms.index_of(transform);
+	//(transforms added since the last build will trigger a rebuild anyway)
+	if (index == -1U || index >= state.is_moved.size()) return;
+	if (state.is_moved[index]) return;
+	state.is_moved[index] = true;
+	state.moved.emplace_back(index);
+}
+
+void Scene::invalidate_bvh() {
+	drawable_bvh.built = false;
+}
+
+void Scene::update_bvh() const {
+	uint32_t pass = next_update_pass();
+	DrawableBVH &state = drawable_bvh;
+
+	//structural changes (drawables or transforms added, or an explicit invalidate_bvh()) need a rebuild:
+	if (!state.built
+	 || state.drawables_generation != drawables.generation
+	 || state.transforms_generation != transforms.generation) {
+		state.built = true;
+		state.drawables_generation = drawables.generation;
+		state.transforms_generation = transforms.generation;
+
+		state.items.clear();
+		state.unbounded.clear();
+		state.untracked.clear();
+		state.item_versions.clear();
+		state.moved.clear();
+		state.is_moved.assign(transforms.size(), false);
+		state.visited.assign(transforms.size(), 0);
+
+		//transform hierarchy, by index:
+		std::vector< uint32_t > parents(transforms.size());
+		for (uint32_t t = 0; t < transforms.size(); ++t) {
+			parents[t] = transforms.index_of(transforms[t].parent);
+		}
+		group_by_key(parents, uint32_t(transforms.size()), &state.child_start, &state.children);
+
+		//world-space boxes of bounded drawables, and the transforms they are attached to:
+		std::vector< glm::vec3 > mins, maxs;
+		std::vector< uint32_t > item_transforms;
+		for (uint32_t i = 0; i < drawables.size(); ++i) {
+			Drawable const &drawable = drawables[i];
+			if (!box_is_finite(drawable.bbox_min, drawable.bbox_max)) {
+				state.unbounded.emplace_back(i);
+				continue;
+			}
+			assert(drawable.transform); //drawables *must* have a transform
+			drawable.transform->update_cache(pass);
+			uint32_t t = transforms.index_of(drawable.transform);
+			if (t == -1U) state.untracked.emplace_back(uint32_t(state.items.size()));
+			item_transforms.emplace_back(t);
+			state.items.emplace_back(i);
+			state.item_versions.emplace_back(drawable.transform->cache.version);
+			mins.emplace_back();
+			maxs.emplace_back();
+			drawable_world_box(drawable, &mins.back(), &maxs.back());
+		}
+		group_by_key(item_transforms, uint32_t(transforms.size()), &state.item_start, &state.transform_items);
+
+		state.bvh.build(mins, maxs);
+		return;
+	}
+
+	auto refit = [&](uint32_t item) {
+		Drawable const &drawable = drawables[state.items[item]];
+		drawable.transform->update_cache(pass);
+		state.item_versions[item] = drawable.transform->cache.version;
+		glm::vec3 min, max;
+		drawable_world_box(drawable, &min, &max);
+		state.bvh.refit(item, min, max);
+	};
+
+	//(drawables attached to transforms from elsewhere can't be tracked, so are always refit)
+	for (uint32_t item : state.untracked) {
+		refit(item);
+	}
+
+	//otherwise, only drawables attached to moved transforms (or their descendants) are refit:
+	for (uint32_t moved : state.moved) {
+		state.is_moved[moved] = false;
+		state.stack.emplace_back(moved);
+		while (!state.stack.empty()) {
+			uint32_t t = state.stack.back();
+			state.stack.pop_back();
+			if (state.visited[t] == pass) continue; //(already refit as part of another moved subtree)
+			state.visited[t] = pass;
+			for (uint32_t i = state.item_start[t]; i < state.item_start[t+1]; ++i) {
+				refit(state.transform_items[i]);
+			}
+			for (uint32_t i = state.child_start[t]; i < state.child_start[t+1]; ++i) {
+				state.stack.emplace_back(state.children[i]);
+			}
+		}
+	}
+	state.moved.clear();
+
+	#ifndef NDEBUG
+	//every box should now match its transform; if not, something moved without a transform_moved() call:
+	for (uint32_t item = 0; item < state.items.size(); ++item) {
+		Drawable const &drawable = drawables[state.items[item]];
+		drawable.transform->update_cache(pass);
+		assert(drawable.transform->cache.version == state.item_versions[item] && "transform moved without Scene::transform_moved()");
+	}
+	#endif
+}
+
+Scene::Drawable const *Scene::pick_ray(glm::vec3 const &ray_start, glm::vec3 const &ray_direction, float *t_) const {
+	update_bvh();
+
+	Drawable const *closest = nullptr;
+	float closest_t = std::numeric_limits< float >::infinity();
+	glm::vec3 inv_direction = 1.0f / ray_direction;
+	drawable_bvh.bvh.query_ray(ray_start, ray_direction, closest_t, [&](uint32_t item, float *max_t) {
+		float t;
+		BVH const &bvh = drawable_bvh.bvh;
+		if (BVH::ray_hits_box(ray_start, inv_direction, *max_t, bvh.item_min[item], bvh.item_max[item], &t) && t < closest_t) {
+			closest_t = t;
+			closest = &drawables[drawable_bvh.items[item]];
+			*max_t = t; //no need to look at anything further away
+		}
+	});
+
+	if (closest && t_) *t_ = closest_t;
+	return closest;
+}
+
+void Scene::pick_sphere(glm::vec3 const &center, float radius, std::vector< Drawable const * > *out_) const {
+	assert(out_);
+	auto &out = *out_;
+
+	update_bvh();
+
+	drawable_bvh.bvh.query_sphere(center, radius, [&](uint32_t item) {
+		out.emplace_back(&drawables[drawable_bvh.items[item]]);
+	});
+}
+
+bool Scene::use_render_queue = false;
+
+//Per-instance data for instanced drawing lives in a buffer texture, InstanceTexels vec4's per instance:
+//  [0-3]: columns of OBJECT_TO_CLIP
+//  [4-6]: rows of OBJECT_TO_LIGHT
+//  [7-9]: columns of NORMAL_TO_LIGHT (.xyz)
+//  [7].w: the drawable's instance_data
+// (matches the fetches in Scene::InstanceGLSL)
+enum : uint32_t { InstanceTexels = 10 };
+
+//(the stride comes from InstanceTexels, so the two can't drift apart)
+static std::string const instance_glsl =
+	"uniform samplerBuffer INSTANCES;\n"
+	"uniform int INSTANCE_BASE;\n"
+	"int instance_texel() { return " + std::to_string(InstanceTexels) + " * (INSTANCE_BASE + gl_InstanceID); }\n"
+	"mat4 instance_OBJECT_TO_CLIP() {\n"
+	"	int t = instance_texel();\n"
+	"	return mat4(texelFetch(INSTANCES, t+0), texelFetch(INSTANCES, t+1), texelFetch(INSTANCES, t+2), texelFetch(INSTANCES, t+3));\n"
+	"}\n"
+	"mat4x3 instance_OBJECT_TO_LIGHT() {\n"
+	"	int t = instance_texel();\n"
+	"	return transpose(mat3x4(texelFetch(INSTANCES, t+4), texelFetch(INSTANCES, t+5), texelFetch(INSTANCES, t+6)));\n"
+	"}\n"
+	"mat3 instance_NORMAL_TO_LIGHT() {\n"
+	"	int t = instance_texel();\n"
+	"	return mat3(texelFetch(INSTANCES, t+7).xyz, texelFetch(INSTANCES, t+8).xyz, texelFetch(INSTANCES, t+9).xyz);\n"
+	"}\n"
+	"int instance_DATA() {\n"
+	"	return int(texelFetch(INSTANCES, instance_texel()+7).w);\n"
+	"}\n"
+;
+char const *Scene::InstanceGLSL = instance_glsl.c_str();
+
+//buffer (and buffer texture) that holds per-instance data; created on first use:
+// (deleted by Scene::release_instance_buffer, since the GL context may be gone by static destruction time)
+struct InstanceBuffer {
+	InstanceBuffer() {
+		glGenBuffers(1, &buffer);
+		glGenTextures(1, &texture);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, InstanceTexels * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		GLint max_texels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+		max_instances = uint32_t(std::max(max_texels, 0)) / InstanceTexels;
+
+		GL_ERRORS();
+	}
+	~InstanceBuffer() {
+		glDeleteTextures(1, &texture);
+		glDeleteBuffers(1, &buffer);
+	}
+	GLuint buffer = 0;
+	GLuint texture = 0;
+	uint32_t max_instances = 0; //instances that fit in GL_MAX_TEXTURE_BUFFER_SIZE texels
+};
+
+static InstanceBuffer *instance_buffer_ = nullptr;
+
+static InstanceBuffer &instance_buffer() {
+	if (!instance_buffer_) instance_buffer_ = new InstanceBuffer();
+	return *instance_buffer_;
+}
+
+void Scene::release_instance_buffer() {
+	delete instance_buffer_;
+	instance_buffer_ = nullptr;
+}
+
+//helper: append the per-instance data for one drawable:
+static void append_instance(DrawMatrices const &matrices, uint32_t instance_data, std::vector< glm::vec4 > *data_) {
+	assert(data_);
+	auto &data = *data_;
+	assert(instance_data < (1U << 24)); //(exactly representable as a float)
+
+	for (uint32_t c = 0; c < 4; ++c) {
+		data.emplace_back(matrices.object_to_clip[c]);
+	}
+	for (uint32_t r = 0; r < 3; ++r) {
+		glm::mat4x3 const &l = matrices.object_to_light;
+		data.emplace_back(l[0][r], l[1][r], l[2][r], l[3][r]);
+	}
+	for (uint32_t c = 0; c < 3; ++c) {
+		data.emplace_back(matrices.normal_to_light[c], (c == 0 ? float(instance_data) : 0.0f));
+	}
+}
+
+//helper: can drawables with this pipeline be batched into instanced draws?
+//scratch space for draw() (see Scene.hpp):
+// (draw() clears each of these before use, so nothing carries over between frames)
+struct Scene::DrawScratch {
+	std::vector< uint32_t > visible; //indices in drawables, in drawing order
+
+	//render queue mode's sort keys:
+	struct QueueEntry {
+		Drawable::Pipeline const *pipeline;
+		float depth; //clip-space w of the drawable's origin -- i.e., distance in front of the camera
+		uint32_t index;
+	};
+	std::vector< QueueEntry > queue;
+
+	//matrices[i] are the matrices for visible[i], computed from:
+	std::vector< DrawMatrices > matrices;
+	std::vector< glm::mat4x3 const * > object_to_world;
+	std::vector< glm::mat3 const * > normal_to_world;
+	std::vector< glm::mat4x3 > dequantized; //local_to_world * dequantization, for quantized meshes
+
+	//instanced batches:
+	struct Batch {
+		uint32_t first = 0; //first instance in instance buffer
+		uint32_t count = 0; //number of instances
+	};
+	std::vector< uint32_t > batch_at; //per position in 'visible'
+	std::vector< Batch > batches;
+	std::vector< uint32_t > candidates; //positions in 'visible'
+	std::vector< glm::vec4 > instance_data;
+
+	//per-object uniform blocks:
+	std::vector< GLintptr > object_offsets; //per position in 'visible'
+	std::vector< uint32_t > positions; //positions in 'visible' of 'blocks'
+	std::vector< ObjectBlock > blocks;
+	std::vector< GLintptr > offsets; //of 'blocks' in the uniform ring
+};
+
+static bool pipeline_can_instance(Scene::Drawable::Pipeline const &pipeline) {
+	return pipeline.instanced.program != 0
+	    && pipeline.program != 0
+	    && pipeline.count != 0
+	    && !pipeline.set_uniforms; //(custom uniforms can't be shared)
+}
+
+//helper: ordering of pipelines that puts those which can share an instanced draw next to each other:
+static bool pipeline_batch_less(Scene::Drawable::Pipeline const &a, Scene::Drawable::Pipeline const &b) {
+	if (a.instanced.program != b.instanced.program) return a.instanced.program < b.instanced.program;
+	if (a.vao != b.vao) return a.vao < b.vao;
+	if (a.type != b.type) return a.type < b.type;
+	if (a.start != b.start) return a.start < b.start;
+	if (a.count != b.count) return a.count < b.count;
+	if (a.index_start != b.index_start) return a.index_start < b.index_start;
+	if (a.index_count != b.index_count) return a.index_count < b.index_count;
+	for (uint32_t i = 0; i < 3; ++i) {
+		if (a.position_offset[i] != b.position_offset[i]) return a.position_offset[i] < b.position_offset[i];
+		if (a.position_scale[i] != b.position_scale[i]) return a.position_scale[i] < b.position_scale[i];
+	}
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (a.textures[i].texture != b.textures[i].texture) return a.textures[i].texture < b.textures[i].texture;
+		if (a.textures[i].texture != 0 && a.textures[i].target != b.textures[i].target) return a.textures[i].target < b.textures[i].target;
+	}
+	return false;
+}
+
 void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
 	glm::mat4 world_to_clip = camera.make_projection() * camera.transform->make_world_to_local();
@@ -76,9 +564,229 @@ void Scene::draw(Camera const &camera) const {
 }
 
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
+	draw_stats = DrawStats();
+
+	//world matrices are only recomputed for transforms that changed:
+	uint32_t pass = next_update_pass();
+
+	//Gather indices of drawables that (might) be in view:
+	if (!draw_scratch) draw_scratch.reset(new DrawScratch());
+	DrawScratch &scratch = *draw_scratch;
+	std::vector< uint32_t > &visible = scratch.visible;
+	visible.clear();
+	if (use_bvh) {
+		//hierarchical culling of world-space bounding boxes:
+		update_bvh();
+		glm::vec4 planes[6];
+		frustum_planes(world_to_clip, planes);
+		draw_stats.tested = drawable_bvh.bvh.query_planes(planes, 6, [&](uint32_t item) {
+			visible.emplace_back(drawable_bvh.items[item]);
+		});
+		draw_stats.culled = uint32_t(drawable_bvh.items.size() - visible.size());
+		visible.insert(visible.end(), drawable_bvh.unbounded.begin(), drawable_bvh.unbounded.end());
+		//draw in the same order as the drawables list (the render queue sorts on its own):
+		if (!use_render_queue) std::sort(visible.begin(), visible.end());
+	} else {
+		//per-drawable culling of object-space bounding boxes:
+		for (uint32_t i = 0; i < drawables.size(); ++i) {
+			Drawable const &drawable = drawables[i];
+			if (box_is_finite(drawable.bbox_min, drawable.bbox_max)) {
+				draw_stats.tested += 1;
+				assert(drawable.transform); //drawables *must* have a transform
+				drawable.transform->update_cache(pass);
+				glm::mat4 object_to_clip = world_to_clip * glm::mat4(drawable.transform->cache.local_to_world);
+				if (box_outside_frustum(object_to_clip, drawable.bbox_min, drawable.bbox_max)) {
+					draw_stats.culled += 1;
+					continue;
+				}
+			}
+			visible.emplace_back(i);
+		}
+	}
+
+	//In render queue mode, order drawables to minimize state changes:
+	if (use_render_queue) {
+		typedef DrawScratch::QueueEntry QueueEntry;
+		std::vector< QueueEntry > &queue = scratch.queue;
+		queue.clear();
+		glm::vec4 w_row = glm::vec4(world_to_clip[0][3], world_to_clip[1][3], world_to_clip[2][3], world_to_clip[3][3]);
+		for (uint32_t index : visible) {
+			Drawable const &drawable = drawables[index];
+			assert(drawable.transform); //drawables *must* have a transform
+			drawable.transform->update_cache(pass);
+			glm::vec3 at = drawable.transform->cache.local_to_world[3];
+			queue.emplace_back(QueueEntry{ &drawable.pipeline, glm::dot(w_row, glm::vec4(at, 1.0f)), index });
+		}
+		//sort by program, then vertex array, then textures, then front-to-back:
+		std::sort(queue.begin(), queue.end(), [](QueueEntry const &a, QueueEntry const &b) {
+			if (a.pipeline->program != b.pipeline->program) return a.pipeline->program < b.pipeline->program;
+			if (a.pipeline->vao != b.pipeline->vao) return a.pipeline->vao < b.pipeline->vao;
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+				Drawable::Pipeline::TextureInfo const &ta = a.pipeline->textures[i];
+				Drawable::Pipeline::TextureInfo const &tb = b.pipeline->textures[i];
+				if (ta.texture != tb.texture) return ta.texture < tb.texture;
+				if (ta.target != tb.target) return ta.target < tb.target;
+			}
+			if (a.depth != b.depth) return a.depth < b.depth;
+			return a.index < b.index;
+		});
+		for (uint32_t i = 0; i < queue.size(); ++i) {
+			visible[i] = queue[i].index;
+		}
+	}
+
+	//Compute matrices for all visible drawables in one batch:
+	// (matrices[i] are the matrices for visible[i])
+	std::vector< DrawMatrices > &matrices = scratch.matrices;
+	matrices.clear();
+	matrices.resize(visible.size());
+	{
+		std::vector< glm::mat4x3 const * > &object_to_world = scratch.object_to_world;
+		std::vector< glm::mat3 const * > &normal_to_world = scratch.normal_to_world;
+		std::vector< glm::mat4x3 > &dequantized = scratch.dequantized; //local_to_world * dequantization, for quantized meshes
+		object_to_world.clear();
+		normal_to_world.clear();
+		dequantized.clear();
+		object_to_world.reserve(visible.size());
+		normal_to_world.reserve(visible.size());
+		dequantized.reserve(visible.size()); //(so pointers remain valid)
+		for (uint32_t index : visible) {
+			Drawable const &drawable = drawables[index];
+			assert(drawable.transform); //drawables *must* have a transform
+			drawable.transform->update_cache(pass);
+			Drawable::Pipeline const &pipeline = drawable.pipeline;
+			if (pipeline.position_offset != glm::vec3(0.0f) || pipeline.position_scale != glm::vec3(1.0f)) {
+				glm::mat4x3 const &l2w = drawable.transform->cache.local_to_world;
+				dequantized.emplace_back(
+					l2w[0] * pipeline.position_scale.x,
+					l2w[1] * pipeline.position_scale.y,
+					l2w[2] * pipeline.position_scale.z,
+					l2w * glm::vec4(pipeline.position_offset, 1.0f)
+				);
+				object_to_world.emplace_back(&dequantized.back());
+			} else {
+				object_to_world.emplace_back(&drawable.transform->cache.local_to_world);
+			}
+			normal_to_world.emplace_back(&drawable.transform->cache.normal_to_world);
+		}
+		//(world_to_light is usually the identity, so its normal matrix is worth special-casing)
+		glm::mat3 normal_world_to_light = glm::mat3(1.0f);
+		if (world_to_light != glm::mat4x3(1.0f)) {
+			normal_world_to_light = glm::inverse(glm::transpose(glm::mat3(world_to_light)));
+		}
+		compute_draw_matrices(world_to_clip, world_to_light, normal_world_to_light,
+			visible.size(), object_to_world.data(), normal_to_world.data(), matrices.data());
+	}
+
+	//Group drawables that can share a glDrawArraysInstanced call:
+	// (batch_at[i] is the batch led by visible[i], or -1U for individually drawn drawables, or BatchMember for followers)
+	enum : uint32_t { BatchMember = -2U };
+	std::vector< uint32_t > &batch_at = scratch.batch_at;
+	batch_at.assign(visible.size(), -1U);
+	typedef DrawScratch::Batch Batch;
+	std::vector< Batch > &batches = scratch.batches;
+	batches.clear();
+	{
+		std::vector< uint32_t > &candidates = scratch.candidates; //positions in 'visible'
+		candidates.clear();
+		for (uint32_t i = 0; i < visible.size(); ++i) {
+			if (pipeline_can_instance(drawables[visible[i]].pipeline)) candidates.emplace_back(i);
+		}
+		//in render queue mode, drawing order is already up to draw(), so any matching drawables can share a batch;
+		// otherwise, only runs of consecutive drawables are batched, so nothing is drawn out of list order:
+		if (use_render_queue) {
+			std::stable_sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+				return pipeline_batch_less(drawables[visible[a]].pipeline, drawables[visible[b]].pipeline);
+			});
+		}
+		auto same_batch = [&](uint32_t a, uint32_t b) {
+			if (!use_render_queue && b != a + 1) return false;
+			Drawable::Pipeline const &pa = drawables[visible[a]].pipeline;
+			Drawable::Pipeline const &pb = drawables[visible[b]].pipeline;
+			return !pipeline_batch_less(pa, pb) && !pipeline_batch_less(pb, pa);
+		};
+
+		std::vector< glm::vec4 > &instance_data = scratch.instance_data;
+		instance_data.clear();
+		uint32_t max_instances = 0; //(queried when the first batch is found)
+		for (uint32_t begin = 0; begin < candidates.size(); /* later */) {
+			uint32_t end = begin + 1;
+			while (end < candidates.size() && same_batch(candidates[end-1], candidates[end])) ++end;
+
+			if (end - begin >= 2 && max_instances == 0) max_instances = instance_buffer().max_instances;
+
+			//instances must fit in the buffer texture; any that don't are drawn individually:
+			uint32_t instances = uint32_t(instance_data.size() / InstanceTexels);
+			uint32_t count = std::min(end - begin, max_instances - std::min(instances, max_instances));
+
+			if (count >= 2) {
+				//(the first candidate is the earliest-drawn, so it leads the batch)
+				batch_at[candidates[begin]] = uint32_t(batches.size());
+				batches.emplace_back();
+				batches.back().first = instances;
+				batches.back().count = count;
+				for (uint32_t c = begin; c < begin + count; ++c) {
+					if (c != begin) batch_at[candidates[c]] = BatchMember;
+					append_instance(matrices[candidates[c]], drawables[visible[candidates[c]]].instance_data, &instance_data);
+				}
+			}
+			begin = end;
+		}
+
+		if (!instance_data.empty()) {
+			InstanceBuffer &ib = instance_buffer();
+			glBindBuffer(GL_TEXTURE_BUFFER, ib.buffer);
+			glBufferData(GL_TEXTURE_BUFFER, instance_data.size() * sizeof(glm::vec4), instance_data.data(), GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glActiveTexture(GL_TEXTURE0 + InstanceTextureUnit);
+			glBindTexture(GL_TEXTURE_BUFFER, ib.texture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+	}
+
+	//Per-object uniform blocks for (non-batched) drawables that use them are uploaded together:
+	// (object_offsets[i] is the offset in the uniform ring of the block for visible[i])
+	std::vector< GLintptr > &object_offsets = scratch.object_offsets;
+	object_offsets.assign(visible.size(), -1);
+	{
+		std::vector< uint32_t > &positions = scratch.positions;
+		std::vector< ObjectBlock > &blocks = scratch.blocks;
+		positions.clear();
+		blocks.clear();
+		for (uint32_t i = 0; i < visible.size(); ++i) {
+			if (batch_at[i] != -1U) continue;
+			Drawable const &drawable = drawables[visible[i]];
+			if (!drawable.pipeline.object_block) continue;
+
+			positions.emplace_back(i);
+			blocks.emplace_back();
+			blocks.back().set(matrices[i].object_to_clip, matrices[i].object_to_light, matrices[i].normal_to_light);
+		}
+		if (!blocks.empty()) {
+			std::vector< GLintptr > &offsets = scratch.offsets;
+			offsets.clear();
+			uniform_ring().upload(blocks.data(), sizeof(ObjectBlock), blocks.size(), &offsets);
+			for (uint32_t b = 0; b < positions.size(); ++b) {
+				object_offsets[positions[b]] = offsets[b];
+			}
+		}
+	}
+
+	//OpenGL state set by previous drawables (only tracked in render queue mode):
+	GLuint current_program = 0;
+	GLuint current_vao = 0;
+	bool current_valid = false; //have program and vao been set yet?
+	Drawable::Pipeline::TextureInfo current_textures[Drawable::Pipeline::TextureCount];
+	uint32_t current_unit = 0; //active texture unit
+
+	//Iterate through visible drawables, sending each one (or each batch) to OpenGL:
+	for (uint32_t position = 0; position < visible.size(); ++position) {
+		if (batch_at[position] == BatchMember) continue;
+		Batch const *batch = (batch_at[position] != -1U ? &batches[batch_at[position]] : nullptr);
+
+		Drawable const &drawable = drawables[visible[position]];
 
-	//Iterate through all drawables, sending each one to OpenGL:
-	for (auto const &drawable : drawables) {
 		//Reference to drawable's pipeline for convenience:
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
 
@@ -87,64 +795,136 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		draw_stats.drawn += (batch ? batch->count : 1);
+		draw_stats.draw_calls += 1;
+
+		GLuint program = (batch ? pipeline.instanced.program : pipeline.program);
 
 		//Set shader program:
-		glUseProgram(pipeline.program);
+		if (!use_render_queue || !current_valid || program != current_program) {
+			glUseProgram(program);
+			current_program = program;
+			draw_stats.state_changes += 1;
+		}
 
 		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		if (!use_render_queue || !current_valid || pipeline.vao != current_vao) {
+			glBindVertexArray(pipeline.vao);
+			current_vao = pipeline.vao;
+			draw_stats.state_changes += 1;
+		}
+
+		current_valid = true;
 
 		//Configure program uniforms:
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4 object_to_world = drawable.transform->make_local_to_world();
+		if (batch) {
+			//per-instance matrices were uploaded above; just say where they start:
+			glUniform1i(pipeline.instanced.INSTANCE_BASE_int, GLint(batch->first));
+		} else if (pipeline.object_block) {
+			//matrices were uploaded above; attach this drawable's block:
+			glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, uniform_ring().buffer, object_offsets[position], sizeof(ObjectBlock));
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * object_to_world;
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
-		}
+			//set any requested custom uniforms:
+			if (pipeline.set_uniforms) pipeline.set_uniforms();
+		} else {
+			//(matrices were computed above)
+			DrawMatrices const &m = matrices[position];
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * object_to_world;
+			//OBJECT_TO_CLIP takes vertices from object space to clip space:
+			if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+				glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(m.object_to_clip));
+			}
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
-		}
+			//OBJECT_TO_CLIP takes vertices from object space to light space:
+			if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+				glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(m.object_to_light));
+			}
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
-		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+			//NORMAL_TO_CLIP takes normals from object space to light space:
+			if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
+				glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(m.normal_to_light));
+			}
+
+			//set any requested custom uniforms:
+			if (pipeline.set_uniforms) pipeline.set_uniforms();
 		}
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+		//(batched drawables' instance_data was uploaded with their matrices)
+		if (!batch && pipeline.INSTANCE_DATA_int != -1U) {
+			glUniform1i(pipeline.INSTANCE_DATA_int, GLint(drawable.instance_data));
+		}
 
 		//set up textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+		if (use_render_queue) {
+			//only change bindings that differ from the previous drawable:
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+				Drawable::Pipeline::TextureInfo const &want = pipeline.textures[i];
+				Drawable::Pipeline::TextureInfo &have = current_textures[i];
+				if (want.texture == have.texture && (want.texture == 0 || want.target == have.target)) continue;
+				if (current_unit != i) {
+					glActiveTexture(GL_TEXTURE0 + i);
+					current_unit = i;
+				}
+				if (have.texture != 0 && (want.texture == 0 || want.target != have.target)) {
+					glBindTexture(have.target, 0);
+				}
+				if (want.texture != 0) {
+					glBindTexture(want.target, want.texture);
+				}
+				have = want;
+				draw_stats.state_changes += 1;
+			}
+		} else {
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+				if (pipeline.textures[i].texture != 0) {
+					glActiveTexture(GL_TEXTURE0 + i);
+					glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+					draw_stats.state_changes += 1;
+				}
 			}
 		}
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+		//draw the object(s):
+		if (pipeline.index_count != 0) {
+			GLvoid const *indices = (GLbyte *)0 + pipeline.index_start * sizeof(GLuint);
+			if (batch) {
+				glDrawElementsInstanced(pipeline.type, pipeline.index_count, GL_UNSIGNED_INT, indices, batch->count);
+			} else {
+				glDrawRangeElements(pipeline.type, pipeline.start, pipeline.start + pipeline.count - 1, pipeline.index_count, GL_UNSIGNED_INT, indices);
+			}
+		} else if (batch) {
+			glDrawArraysInstanced(pipeline.type, pipeline.start, pipeline.count, batch->count);
+		} else {
+			glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+		}
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
+		//un-bind textures (render queue mode leaves them bound for the next drawable):
+		if (!use_render_queue) {
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+				if (pipeline.textures[i].texture != 0) {
+					glActiveTexture(GL_TEXTURE0 + i);
+					glBindTexture(pipeline.textures[i].target, 0);
+				}
 			}
+			glActiveTexture(GL_TEXTURE0);
 		}
-		glActiveTexture(GL_TEXTURE0);
 
 	}
 
+	//un-bind any textures left bound by render queue mode:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (current_textures[i].texture != 0) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(current_textures[i].target, 0);
+		}
+	}
+	if (!batches.empty()) {
+		glActiveTexture(GL_TEXTURE0 + InstanceTextureUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
 	glUseProgram(0);
 	glBindVertexArray(0);
 
@@ -152,123 +932,191 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 }
 
 
+//Scene file entries shared by both versions of the format:
+struct SceneFileMesh {
+	uint32_t transform;
+	uint32_t name_begin;
+	uint32_t name_end;
+};
+static_assert(sizeof(SceneFileMesh) == 4 + 4 + 4, "SceneFileMesh is packed.");
+
+struct SceneFileCamera {
+	uint32_t transform;
+	char type[4]; //"pers" or "orth"
+	float data; //fov in degrees for 'pers', scale for 'orth'
+	float clip_near, clip_far;
+};
+static_assert(sizeof(SceneFileCamera) == 4 + 4 + 4 + 4 + 4, "SceneFileCamera is packed.");
+
+struct SceneFileLight {
+	uint32_t transform;
+	char type;
+	glm::u8vec3 color;
+	float energy;
+	float distance;
+	float fov;
+};
+static_assert(sizeof(SceneFileLight) == 4 + 1 + 3 + 4 + 4 + 4, "SceneFileLight is packed.");
+
 void Scene::load(std::string const &filename,
 	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 
-	std::ifstream file(filename, std::ios::binary);
+	//loaded transforms are appended after any existing ones:
+	size_t base = transforms.size();
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	//File contents are used in place (see ChunkReader in read_write_chunk.hpp):
+	ChunkReader file(filename);
 
-	struct HierarchyEntry {
-		uint32_t parent;
-		uint32_t name_begin;
-		uint32_t name_end;
-		glm::vec3 position;
-		glm::quat rotation;
-		glm::vec3 scale;
-	};
-	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
-
-	struct MeshEntry {
-		uint32_t transform;
-		uint32_t name_begin;
-		uint32_t name_end;
-	};
-	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
-
-	struct CameraEntry {
-		uint32_t transform;
-		char type[4]; //"pers" or "orth"
-		float data; //fov in degrees for 'pers', scale for 'orth'
-		float clip_near, clip_far;
-	};
-	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > cameras;
-	read_chunk(file, "cam0", &cameras);
-
-	struct LightEntry {
-		uint32_t transform;
-		char type;
-		glm::u8vec3 color;
-		float energy;
-		float distance;
-		float fov;
-	};
-	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > lights;
-	read_chunk(file, "lmp0", &lights);
+	ChunkSpan< char > names;
+	ChunkSpan< SceneFileMesh > meshes;
+	ChunkSpan< SceneFileCamera > cameras;
+	ChunkSpan< SceneFileLight > lights;
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
-	}
+	if (file.peek() == "scn2") {
+		//--------------------------------
+		//Version 2: hierarchy is stored in topological order as separate arrays.
+		ChunkSpan< uint32_t > version = file.read< uint32_t >("scn2");
+		if (version.size() != 1 || version[0] != 2) {
+			throw std::runtime_error("scene file '" + filename + "' has unsupported version");
+		}
 
-	//--------------------------------
-	//Now that file is loaded, create transforms for hierarchy entries:
+		names = file.read< char >("str1");
 
-	std::vector< Transform * > hierarchy_transforms;
-	hierarchy_transforms.reserve(hierarchy.size());
+		ChunkSpan< uint32_t > parents = file.read< uint32_t >("prn1");
 
-	for (auto const &h : hierarchy) {
-		transforms.emplace_back();
-		Transform *t = &transforms.back();
-		if (h.parent != -1U) {
-			if (h.parent >= hierarchy_transforms.size()) {
-				throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
-			}
-			t->parent = hierarchy_transforms[h.parent];
+		struct NameRange {
+			uint32_t begin, end;
+		};
+		static_assert(sizeof(NameRange) == 4 + 4, "NameRange is packed.");
+		ChunkSpan< NameRange > name_ranges = file.read< NameRange >("nam1");
+
+		struct TRS {
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+		};
+		static_assert(sizeof(TRS) == 4*3 + 4*4 + 4*3, "TRS is packed.");
+		ChunkSpan< TRS > trs = file.read< TRS >("xfm1");
+
+		if (name_ranges.size() != parents.size() || trs.size() != parents.size()) {
+			throw std::runtime_error("scene file '" + filename + "' has mismatched hierarchy array sizes");
 		}
 
-		if (h.name_begin <= h.name_end && h.name_end <= names.size()) {
-			t->name = std::string(names.begin() + h.name_begin, names.begin() + h.name_end);
-		} else {
+		meshes = file.read< SceneFileMesh >("msh0");
+		cameras = file.read< SceneFileCamera >("cam0");
+		lights = file.read< SceneFileLight >("lmp0");
+
+		//create transforms for hierarchy entries:
+		for (size_t i = 0; i < parents.size(); ++i) {
+			transforms.emplace_back();
+			Transform *t = &transforms.back();
+			if (parents[i] != -1U) {
+				if (parents[i] >= i) {
+					throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
+				}
+				t->parent = &transforms[base + parents[i]];
+			}
+
+			NameRange const &n = name_ranges[i];
+			if (n.begin <= n.end && n.end <= names.size()) {
+				t->name.assign(names.begin() + n.begin, names.begin() + n.end);
+			} else {
 				throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
+			}
+
+			t->position = trs[i].position;
+			t->rotation = trs[i].rotation;
+			t->scale = trs[i].scale;
 		}
+	} else {
+		//--------------------------------
+		//Version 1: hierarchy entries combine parent, name, and transform:
+		names = file.read< char >("str0");
+
+		struct HierarchyEntry {
+			uint32_t parent;
+			uint32_t name_begin;
+			uint32_t name_end;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+		};
+		static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
+		ChunkSpan< HierarchyEntry > hierarchy = file.read< HierarchyEntry >("xfh0");
+
+		meshes = file.read< SceneFileMesh >("msh0");
+		cameras = file.read< SceneFileCamera >("cam0");
+		lights = file.read< SceneFileLight >("lmp0");
+
+		//create transforms for hierarchy entries:
+		for (size_t i = 0; i < hierarchy.size(); ++i) {
+			HierarchyEntry const &h = hierarchy[i];
+			transforms.emplace_back();
+			Transform *t = &transforms.back();
+			if (h.parent != -1U) {
+				if (h.parent >= i) {
+					throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
+				}
+				t->parent = &transforms[base + h.parent];
+			}
 
-		t->position = h.position;
-		t->rotation = h.rotation;
-		t->scale = h.scale;
+			if (h.name_begin <= h.name_end && h.name_end <= names.size()) {
+				t->name.assign(names.begin() + h.name_begin, names.begin() + h.name_end);
+			} else {
+					throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
+			}
 
-		hierarchy_transforms.emplace_back(t);
+			t->position = h.position;
+			t->rotation = h.rotation;
+			t->scale = h.scale;
+		}
 	}
-	assert(hierarchy_transforms.size() == hierarchy.size());
 
-	for (auto const &m : meshes) {
-		if (m.transform >= hierarchy_transforms.size()) {
+	if (!file.at_end()) {
+		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
+	}
+
+	//--------------------------------
+	//Now that transforms exist, attach meshes, cameras, and lights:
+
+	size_t transforms_count = transforms.size() - base;
+
+	std::string name;
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		SceneFileMesh const &m = meshes[i];
+		if (m.transform >= transforms_count) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid transform index (" + std::to_string(m.transform) + ")");
 		}
 		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
 		}
-		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
+		name.assign(names.begin() + m.name_begin, names.begin() + m.name_end);
 
 		if (on_drawable) {
-			on_drawable(*this, hierarchy_transforms[m.transform], name);
+			on_drawable(*this, &transforms[base + m.transform], name);
 		}
 
 	}
 
-	for (auto const &c : cameras) {
-		if (c.transform >= hierarchy_transforms.size()) {
+	for (size_t i = 0; i < cameras.size(); ++i) {
+		SceneFileCamera const &c = cameras[i];
+		if (c.transform >= transforms_count) {
 			throw std::runtime_error("scene file '" + filename + "' contains camera entry with invalid transform index (" + std::to_string(c.transform) + ")");
 		}
 		if (std::string(c.type, 4) != "pers") {
 			std::cout << "Ignoring non-perspective camera (" + std::string(c.type, 4) + ") stored in file." << std::endl;
 			continue;
 		}
-		this->cameras.emplace_back(hierarchy_transforms[c.transform]);
+		this->cameras.emplace_back(&transforms[base + c.transform]);
 		Camera *camera = &this->cameras.back();
 		camera->fovy = c.data / 180.0f * 3.1415926f; //FOV is stored in degrees; convert to radians.
 		camera->near = c.clip_near;
 		//N.b. far plane is ignored because cameras use infinite perspective matrices.
 	}
 
-	for (auto const &l : lights) {
-		if (l.transform >= hierarchy_transforms.size()) {
+	for (size_t i = 0; i < lights.size(); ++i) {
+		SceneFileLight const &l = lights[i];
+		if (l.transform >= transforms_count) {
 			throw std::runtime_error("scene file '" + filename + "' contains lamp entry with invalid transform index (" + std::to_string(l.transform) + ")");
 		}
 		if (l.type == 'p') {
@@ -283,7 +1131,7 @@ void Scene::load(std::string const &filename,
 			std::cout << "Ignoring unrecognized lamp type (" + std::string(&l.type, 1) + ") stored in file." << std::endl;
 			continue;
 		}
-		this->lights.emplace_back(hierarchy_transforms[l.transform]);
+		this->lights.emplace_back(&transforms[base + l.transform]);
 		Light *light = &this->lights.back();
 		light->type = static_cast<Light::Type>(l.type);
 		light->energy = glm::vec3(l.color) / 255.0f * l.energy;
@@ -295,6 +1143,9 @@ void Scene::load(std::string const &filename,
 
 //-------------------------
 
+Scene::Scene() {
+}
+
 Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
 	load(filename, on_drawable);
 }
@@ -308,50 +1159,66 @@ Scene &Scene::operator=(Scene const &other) {
 	return *this;
 }
 
-void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
+Scene::~Scene() {
+}
 
-	std::unordered_map< Transform const *, Transform * > t2t_temp;
-	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
+void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map) {
 
-	transform_to_transform.clear();
+	//copied transforms are appended after any existing ones:
+	size_t base = transforms.size();
 
-	//null transform maps to itself:
-	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
+	//drawables will change, so the bounding volume hierarchy will need to be rebuilt:
+	drawable_bvh = DrawableBVH();
 
-	//Copy transforms and store mapping:
+	//map a transform in 'other' to the corresponding transform in this scene:
+	auto remap = [&](Transform const *t) -> Transform * {
+		if (t == nullptr) return nullptr;
+		uint32_t index = other.transforms.index_of(t);
+		if (index == -1U) {
+			throw std::runtime_error("scene being copied references a transform it does not contain");
+		}
+		return &transforms[base + index];
+	};
+
+	//Copy transforms:
 	for (auto const &t : other.transforms) {
 		transforms.emplace_back();
 		transforms.back().name = t.name;
 		transforms.back().position = t.position;
 		transforms.back().rotation = t.rotation;
 		transforms.back().scale = t.scale;
-		transforms.back().parent = t.parent; //will update later
-
-		//store mapping between transforms old and new:
-		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
-		assert(ret.second);
 	}
 
 	//update transform parents:
-	for (auto &t : transforms) {
-		t.parent = transform_to_transform.at(t.parent);
+	for (size_t i = 0; i < other.transforms.size(); ++i) {
+		transforms[base + i].parent = remap(other.transforms[i].parent);
+	}
+
+	//if requested, store mapping between transforms old and new:
+	if (transform_map) {
+		transform_map->clear();
+		//null transform maps to itself:
+		transform_map->insert(std::make_pair(nullptr, nullptr));
+		for (size_t i = 0; i < other.transforms.size(); ++i) {
+			transform_map->insert(std::make_pair(&other.transforms[i], &transforms[base + i]));
+		}
 	}
 
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
-		d.transform = transform_to_transform.at(d.transform);
+		d.transform = remap(d.transform);
 	}
 
 	//copy other's cameras, updating transform pointers:
 	cameras = other.cameras;
 	for (auto &c : cameras) {
-		c.transform = transform_to_transform.at(c.transform);
+		c.transform = remap(c.transform);
 	}
 
 	//copy other's lights, updating transform pointers:
 	lights = other.lights;
 	for (auto &l : lights) {
-		l.transform = transform_to_transform.at(l.transform);
+		l.transform = remap(l.transform);
 	}
 }
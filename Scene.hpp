@@ -13,17 +13,21 @@
  */
 
 #include "GL.hpp"
+#include "ChunkList.hpp"
+#include "BVH.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-#include <list>
 #include <memory>
 #include <functional>
+#include <limits>
 #include <string>
 #include <vector>
 #include <unordered_map>
 
+struct Mesh;
+
 struct Scene {
 	struct Transform {
 		//Transform names are useful for debugging and looking up locations in a loaded scene:
@@ -45,6 +49,32 @@ struct Scene {
 		glm::mat4 make_local_to_world() const;
 		glm::mat4 make_world_to_local() const;
 
+		//World matrices are cached; these return the cached copy, recomputing it first
+		// if position/rotation/scale/parent of this transform (or any ancestor) changed:
+		glm::mat4x3 const &get_local_to_world() const;
+		glm::mat4x3 const &get_world_to_local() const;
+
+		//Cached world matrices and the state they were computed from:
+		struct Cache {
+			bool valid = false;
+			glm::vec3 position;
+			glm::quat rotation;
+			glm::vec3 scale;
+			Transform const *parent = nullptr;
+			uint32_t parent_version = 0; //parent->cache.version when matrices were computed
+			uint32_t version = 0; //incremented every time matrices are recomputed
+			uint32_t pass = 0; //last update pass in which this cache was checked
+			glm::mat4x3 local_to_world;
+			glm::mat4x3 world_to_local;
+			glm::mat3 normal_to_world; //inverse transpose of local_to_world's upper 3x3
+			float uniform_scale = 0.0f; //scale of local_to_world if it is rotation * uniform scale, otherwise zero
+		};
+		mutable Cache cache;
+
+		//bring cache up to date (will also update parents):
+		// 'pass' (if non-zero) lets transforms shared by many callers skip re-checking within one update pass
+		void update_cache(uint32_t pass = 0) const;
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -56,6 +86,19 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//Object-space bounding box, used to skip drawables outside the view frustum:
+		// (the default, infinite, box is never culled; set_mesh copies Mesh::min / Mesh::max here)
+		glm::vec3 bbox_min = glm::vec3(-std::numeric_limits< float >::infinity());
+		glm::vec3 bbox_max = glm::vec3( std::numeric_limits< float >::infinity());
+
+		//copy mesh's vertex/index ranges, dequantization, and bounding box to pipeline and bbox_min/bbox_max:
+		void set_mesh(Mesh const &mesh);
+
+		//(optional) per-drawable value for the pipeline's programs -- e.g., where a skinned drawable's bone palette starts:
+		// instanced programs read it with instance_DATA() (see InstanceGLSL), others through the INSTANCE_DATA_int uniform
+		// (passed through a float, so must be less than 2^24)
+		uint32_t instance_data = 0;
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -67,13 +110,38 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//(optional) indexed drawing, using the element array buffer attached to 'vao':
+			// if index_count is nonzero, draws with glDrawRangeElements (GL_UNSIGNED_INT indices), with start/count bounding the vertices used
+			GLuint index_start = 0; //first element to draw
+			GLuint index_count = 0; //number of elements to draw
+
+			//(optional) dequantization of the Position attribute (set_mesh copies Mesh::position_offset / Mesh::position_scale here):
+			// folded into the object-to-clip and object-to-light matrices; normals are unaffected
+			glm::vec3 position_offset = glm::vec3(0.0f);
+			glm::vec3 position_scale = glm::vec3(1.0f);
+
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
+			bool object_block = false; //if set, the above matrices are supplied in the "Object" uniform block instead (see UniformBlocks.hpp)
+			GLuint INSTANCE_DATA_int = -1U; //uniform location for the drawable's instance_data (when not drawn instanced)
 
 			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
 
+			//copy mesh's primitive type, vertex/index ranges, and dequantization to the fields above:
+			// (Drawable::set_mesh also copies the bounding box)
+			void set_mesh(Mesh const &mesh);
+
+			//(optional) instanced variant of 'program', which reads its matrices using Scene::InstanceGLSL:
+			// visible drawables that share a pipeline (and have no set_uniforms) are drawn with one glDrawArraysInstanced (or glDrawElementsInstanced)
+			// (outside of render queue mode, only if they are next to each other in drawing order, so list order is kept)
+			// n.b. must use the same attribute locations as 'program', since they share 'vao'
+			struct Instanced {
+				GLuint program = 0;
+				GLuint INSTANCE_BASE_int = -1U; //uniform location for index of the batch's first instance
+			} instanced;
+
 			//texture objects to bind for the first TextureCount textures:
 			enum : uint32_t { TextureCount = 4 };
 			struct TextureInfo {
@@ -118,10 +186,16 @@ struct Scene {
 	};
 
 	//Scenes, of course, may have many of the above objects:
-	std::list< Transform > transforms;
-	std::list< Drawable > drawables;
-	std::list< Camera > cameras;
-	std::list< Light > lights;
+	// (stored contiguously, with stable addresses -- see ChunkList.hpp)
+	ChunkList< Transform > transforms;
+	ChunkList< Drawable > drawables;
+	ChunkList< Camera > cameras;
+	ChunkList< Light > lights;
+
+	//Bring all cached world matrices up to date:
+	// (only transforms which -- or whose ancestors -- have changed since the last call are recomputed)
+	// n.b. draw() calls this (for the transforms it needs) automatically
+	void update_world_matrices() const;
 
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
 	void draw(Camera const &camera) const;
@@ -129,6 +203,56 @@ struct Scene {
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//Counters from the most recent call to draw():
+	struct DrawStats {
+		uint32_t tested = 0; //bounding boxes tested against the view frustum (BVH nodes when use_bvh is set, otherwise drawables)
+		uint32_t culled = 0; //...of which were outside the frustum and skipped
+		uint32_t drawn = 0; //drawables actually sent to OpenGL
+		uint32_t state_changes = 0; //program, vertex array, and texture binds issued
+		uint32_t draw_calls = 0; //glDraw* calls issued (less than 'drawn' when instancing)
+	};
+	mutable DrawStats draw_stats;
+
+	//GLSL declarations for instanced programs (see Drawable::Pipeline::instanced):
+	// instance_OBJECT_TO_CLIP(), instance_OBJECT_TO_LIGHT(), and instance_NORMAL_TO_LIGHT() return the matrices
+	// that the non-instanced program would receive as uniforms, and instance_DATA() returns the drawable's instance_data;
+	// the INSTANCES sampler must be set to InstanceTextureUnit
+	static char const *InstanceGLSL;
+	enum : uint32_t { InstanceTextureUnit = Drawable::Pipeline::TextureCount };
+
+	//delete the (shared, created on first use) per-instance data buffer; call before destroying the GL context:
+	static void release_instance_buffer();
+
+	//In render queue mode, draw() sorts visible drawables by (program, vertex array, textures, depth)
+	// and only issues state changes when they differ from the previous drawable's:
+	// (global, so the F4 draw timing in main.cpp can compare both modes; toggle with F5)
+	// n.b. drawables' set_uniforms functions must not change program, vertex array, or texture bindings
+	static bool use_render_queue;
+
+	//Drawables with bounds are also tracked in a bounding volume hierarchy over their world-space boxes:
+	// when 'use_bvh' is set, draw() culls with the hierarchy instead of testing every drawable
+	// (so drawing costs depend on what is in view, not on scene size)
+	bool use_bvh = false;
+
+	//Keeping the hierarchy current doesn't scan the scene, so changes must be reported:
+	// - after changing a transform's position/rotation/scale, call transform_moved()
+	//   (drawables attached to it or to any of its descendants are refit);
+	// - after changing a drawable's bounds or transform, or a transform's parent, call invalidate_bvh()
+	//   (the hierarchy is rebuilt);
+	// adding drawables or transforms (or clearing the lists) is noticed automatically
+	void transform_moved(Transform const *transform);
+	void invalidate_bvh();
+
+	//bring the hierarchy up to date: refits drawables moved by reported transforms,
+	// and rebuilds after structural changes (called automatically by draw() and the pick_* functions)
+	void update_bvh() const;
+
+	//Picking queries against drawables' world-space bounding boxes (drawables without bounds are ignored):
+	// closest drawable whose box is hit by ray_start + t * ray_direction (t >= 0), or nullptr; optionally returns t:
+	Drawable const *pick_ray(glm::vec3 const &ray_start, glm::vec3 const &ray_direction, float *t = nullptr) const;
+	// appends all drawables whose boxes overlap the sphere to *out:
+	void pick_sphere(glm::vec3 const &center, float radius, std::vector< Drawable const * > *out) const;
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
@@ -137,14 +261,49 @@ struct Scene {
 	);
 
 	//empty scene:
-	Scene() = default;
+	Scene();
 
 	//load a scene:
 	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
+	// (transform pointers are remapped by index, so no lookup table is built unless transform_map is requested)
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+
+	~Scene(); //(defined in Scene.cpp, where DrawScratch is complete)
+
+	//-- internals --
+
+	//state used by update_bvh() to keep 'bvh' in sync with 'drawables':
+	struct DrawableBVH {
+		bool built = false;
+		uint32_t drawables_generation = 0; //drawables.generation when built
+		uint32_t transforms_generation = 0; //transforms.generation when built
+
+		BVH bvh;
+		std::vector< uint32_t > items; //bvh item -> index in drawables
+		std::vector< uint32_t > unbounded; //indices of drawables without (finite) bounds
+		std::vector< uint32_t > untracked; //bvh items whose transform isn't in 'transforms' (refit on every update)
+		std::vector< uint32_t > item_versions; //per bvh item, transform->cache.version its box was computed from (checked in debug builds)
+
+		//per transform index, its children and the bvh items attached to it:
+		// (children of transform t are children[child_start[t]] .. children[child_start[t+1]-1]; same for items)
+		std::vector< uint32_t > child_start, children;
+		std::vector< uint32_t > item_start, transform_items;
+
+		//transforms reported by transform_moved() since the last update:
+		std::vector< uint32_t > moved;
+		std::vector< bool > is_moved; //per transform
+		std::vector< uint32_t > visited; //per transform; update pass in which its items were last refit
+		std::vector< uint32_t > stack; //scratch for walking moved subtrees
+	};
+	mutable DrawableBVH drawable_bvh;
+
+	//scratch space for draw(), kept to avoid reallocating every frame:
+	// (defined in Scene.cpp; allocated by the first draw() and not copied with the scene)
+	struct DrawScratch;
+	mutable std::unique_ptr< DrawScratch > draw_scratch;
 };
@@ -25,9 +25,7 @@ ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
 		scene_drawable->pipeline = show_meshes_program_pipeline;
 		scene_drawable->pipeline.vao = vao;
 		//these will be updated by the mesh selection code:
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.set_mesh(Mesh()); //(draws nothing)
 	}
 
 	//select first mesh in buffer:
@@ -158,16 +156,12 @@ void ShowMeshesMode::select_prev_mesh() {
 
 	if (f != buffer.meshes.end()) {
 		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
+		scene_drawable->pipeline.set_mesh(f->second);
 		current_mesh_min = f->second.min;
 		current_mesh_max = f->second.max;
 	} else {
 		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.set_mesh(Mesh()); //(draws nothing)
 		current_mesh_min = glm::vec3(0.0f);
 		current_mesh_max = glm::vec3(0.0f);
 	}
@@ -187,16 +181,12 @@ void ShowMeshesMode::select_next_mesh() {
 
 	if (f != buffer.meshes.end()) {
 		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
+		scene_drawable->pipeline.set_mesh(f->second);
 		current_mesh_min = f->second.min;
 		current_mesh_max = f->second.max;
 	} else {
 		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.set_mesh(Mesh()); //(draws nothing)
 		current_mesh_min = glm::vec3(0.0f);
 		current_mesh_max = glm::vec3(0.0f);
 	}
@@ -0,0 +1,81 @@
+#include "SpatialHash.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+SpatialHash::SpatialHash(float cell_size_, uint32_t table_size) : cell_size(cell_size_), inv_cell_size(1.0f / cell_size_) {
+	if (!(cell_size > 0.0f)) {
+		throw std::runtime_error("SpatialHash: cell size must be positive (got " + std::to_string(cell_size) + ").");
+	}
+	//table sizes are powers of two, so slots can be found with a mask:
+	fixed_table_size = 0;
+	if (table_size) {
+		fixed_table_size = 1;
+		while (fixed_table_size < table_size) fixed_table_size *= 2;
+	}
+}
+
+glm::ivec3 SpatialHash::cell_of(glm::vec3 const &point) const {
+	return glm::ivec3(
+		int32_t(std::floor(point.x * inv_cell_size)),
+		int32_t(std::floor(point.y * inv_cell_size)),
+		int32_t(std::floor(point.z * inv_cell_size))
+	);
+}
+
+uint32_t SpatialHash::slot_of(glm::ivec3 const &cell) const {
+	//(hash from Teschner et al., "Optimized Spatial Hashing for Collision Detection of Deformable Objects")
+	uint32_t hash = (uint32_t(cell.x) * 73856093U) ^ (uint32_t(cell.y) * 19349663U) ^ (uint32_t(cell.z) * 83492791U);
+	return hash & slot_mask;
+}
+
+SpatialHash::Range SpatialHash::slot_entries(glm::ivec3 const &cell) const {
+	if (ids.empty()) return Range{0, 0};
+	uint32_t slot = slot_of(cell);
+	return Range{slot_start[slot], slot_start[slot + 1]};
+}
+
+void SpatialHash::build(std::vector< glm::vec3 > const &centers_, std::vector< float > const &radii_) {
+	assert(centers_.size() == radii_.size());
+	uint32_t count = uint32_t(centers_.size());
+
+	uint32_t table_size = fixed_table_size;
+	if (table_size == 0) {
+		//about two slots per sphere keeps slots short:
+		table_size = 1;
+		while (table_size < 2 * count) table_size *= 2;
+	}
+	slot_start.assign(table_size + 1, 0);
+	slot_mask = table_size - 1;
+
+	//count spheres per slot:
+	entry_slot.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (!(2.0f * radii_[i] <= cell_size)) {
+			throw std::runtime_error("SpatialHash: sphere " + std::to_string(i) + " (radius " + std::to_string(radii_[i]) + ") is wider than a cell (" + std::to_string(cell_size) + ").");
+		}
+		entry_slot[i] = slot_of(cell_of(centers_[i]));
+		slot_start[entry_slot[i] + 1] += 1;
+	}
+
+	//prefix sum gives the first entry of each slot:
+	for (uint32_t s = 0; s < table_size; ++s) {
+		slot_start[s + 1] += slot_start[s];
+	}
+
+	//scatter spheres into their slots:
+	// (in order of index within each slot, so results don't depend on anything but the input)
+	ids.resize(count);
+	centers.resize(count);
+	radii.resize(count);
+	cells.resize(count);
+	slot_fill.assign(slot_start.begin(), slot_start.end() - 1);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t e = slot_fill[entry_slot[i]]++;
+		ids[e] = i;
+		centers[e] = centers_[i];
+		radii[e] = radii_[i];
+		cells[e] = cell_of(centers_[i]);
+	}
+}
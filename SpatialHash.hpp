@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+ * SpatialHash is a uniform grid over many similarly-sized spheres (marbles,
+ *  particles, ...), for finding overlapping pairs and nearby objects.
+ *
+ * Each sphere is stored in the cell containing its center, so the cell size
+ *  must be at least the largest sphere diameter; then overlapping spheres are
+ *  always in the same or neighboring cells.
+ *
+ * Cells are hashed into a fixed-size table. build() counting-sorts the
+ *  spheres by hashed cell key and stores their centers, radii, and cells in
+ *  that order, so each table slot is a contiguous run of entries.
+ *  (Cells that hash to the same slot share it; entries remember their cell,
+ *  so queries can tell them apart.)
+ *
+ * Rebuilding every frame is linear in the number of spheres.
+ *
+ * (CollisionWorld's sweep and prune handles mixed sizes better; this is
+ *  for large numbers of small, uniformly sized bodies.)
+ *
+ */
+
+#include "collide.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+struct SpatialHash {
+	//'table_size' is the number of slots cells are hashed into; 0 picks one based on the number of spheres at each build():
+	SpatialHash(float cell_size, uint32_t table_size = 0);
+
+	//(re-)build over spheres (centers[i], radii[i]):
+	// throws if any sphere is wider than a cell
+	void build(std::vector< glm::vec3 > const &centers, std::vector< float > const &radii);
+
+	uint32_t size() const { return uint32_t(ids.size()); }
+
+	//cell containing a point:
+	glm::ivec3 cell_of(glm::vec3 const &point) const;
+
+	//entries stored in the table slot for 'cell':
+	// (may include entries from other cells that hash to the same slot; check cells[i])
+	struct Range {
+		uint32_t first, last; //entries [first,last)
+		struct iterator {
+			uint32_t i;
+			uint32_t operator*() const { return i; }
+			iterator &operator++() { ++i; return *this; }
+			bool operator!=(iterator const &o) const { return i != o.i; }
+		};
+		iterator begin() const { return iterator{first}; }
+		iterator end() const { return iterator{last}; }
+	};
+	Range slot_entries(glm::ivec3 const &cell) const;
+
+	//call fn(id) for every sphere overlapping the query sphere:
+	// (query radius must be no larger than half a cell, like the stored spheres)
+	template< typename F >
+	void query_sphere(glm::vec3 const &center, float radius, F const &fn) const;
+
+	//call fn(a, b) once for every pair of overlapping spheres:
+	// (order is deterministic for a given build)
+	template< typename F >
+	void for_each_pair(F const &fn) const;
+
+	//-- internals --
+
+	float cell_size;
+	float inv_cell_size;
+	uint32_t fixed_table_size;
+
+	uint32_t slot_of(glm::ivec3 const &cell) const;
+
+	//slot s holds entries [slot_start[s], slot_start[s+1]):
+	std::vector< uint32_t > slot_start;
+	uint32_t slot_mask = 0; //(table size - 1)
+
+	//entries, in slot order:
+	std::vector< uint32_t > ids; //index into build()'s arrays
+	std::vector< glm::vec3 > centers;
+	std::vector< float > radii;
+	std::vector< glm::ivec3 > cells;
+
+	//scratch for build():
+	std::vector< uint32_t > entry_slot;
+	std::vector< uint32_t > slot_fill;
+};
+
+//------------------------------------------------------
+
+template< typename F >
+void SpatialHash::query_sphere(glm::vec3 const &center, float radius, F const &fn) const {
+	assert(2.0f * radius <= cell_size);
+	if (ids.empty()) return;
+	glm::ivec3 cell = cell_of(center);
+	for (int32_t dz = -1; dz <= 1; ++dz) {
+		for (int32_t dy = -1; dy <= 1; ++dy) {
+			for (int32_t dx = -1; dx <= 1; ++dx) {
+				glm::ivec3 neighbor = cell + glm::ivec3(dx, dy, dz);
+				for (uint32_t i : slot_entries(neighbor)) {
+					if (cells[i] != neighbor) continue;
+					if (collide_sphere_vs_sphere(center, radius, centers[i], radii[i])) fn(ids[i]);
+				}
+			}
+		}
+	}
+}
+
+template< typename F >
+void SpatialHash::for_each_pair(F const &fn) const {
+	//each pair is found once by only looking "forward" from each cell:
+	static const glm::ivec3 Forward[13] = {
+		glm::ivec3( 1, 0, 0),
+		glm::ivec3(-1, 1, 0), glm::ivec3( 0, 1, 0), glm::ivec3( 1, 1, 0),
+		glm::ivec3(-1,-1, 1), glm::ivec3( 0,-1, 1), glm::ivec3( 1,-1, 1),
+		glm::ivec3(-1, 0, 1), glm::ivec3( 0, 0, 1), glm::ivec3( 1, 0, 1),
+		glm::ivec3(-1, 1, 1), glm::ivec3( 0, 1, 1), glm::ivec3( 1, 1, 1),
+	};
+
+	for (uint32_t i = 0; i < ids.size(); ++i) {
+		glm::ivec3 const &cell = cells[i];
+		//same cell -- later entries in the same slot:
+		uint32_t slot_end = slot_start[slot_of(cell) + 1];
+		for (uint32_t j = i + 1; j < slot_end; ++j) {
+			if (cells[j] != cell) continue;
+			if (collide_sphere_vs_sphere(centers[i], radii[i], centers[j], radii[j])) fn(ids[i], ids[j]);
+		}
+		//neighboring cells:
+		for (glm::ivec3 const &offset : Forward) {
+			glm::ivec3 neighbor = cell + offset;
+			for (uint32_t j : slot_entries(neighbor)) {
+				if (cells[j] != neighbor) continue;
+				if (collide_sphere_vs_sphere(centers[i], radii[i], centers[j], radii[j])) fn(ids[i], ids[j]);
+			}
+		}
+	}
+}
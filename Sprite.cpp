@@ -4,7 +4,6 @@
 #include "read_write_chunk.hpp"
 #include "load_save_png.hpp"
 
-#include <fstream>
 
 SpriteAtlas::SpriteAtlas(std::string const &filebase) {
 	std::string png_path = filebase + ".png";
@@ -43,14 +42,12 @@ SpriteAtlas::SpriteAtlas(std::string const &filebase) {
 
 	// ----- load the sprite location data -----
 
-	//read from atlas_path in binary mode:
-	std::ifstream in(atlas_path, std::ios::binary);
+	//map atlas_path (chunks are used in place):
+	ChunkReader in(atlas_path);
 
 	//sprite atlas is stored as two chunks:
 	// (1) a 'str0' chunk with string data:
-	std::vector< char > strings;
-
-	read_chunk(in, "str0", &strings);
+	ChunkSpan< char > strings = in.read< char >("str0");
 
 	// (2) a 'spr0' chunk with sprite data:
 	struct SpriteData {
@@ -59,9 +56,7 @@ SpriteAtlas::SpriteAtlas(std::string const &filebase) {
 		glm::vec2 max_px;
 		glm::vec2 anchor_px;
 	};
-	std::vector< SpriteData > datas;
-
-	read_chunk(in, "spr0", &datas);
+	ChunkSpan< SpriteData > datas = in.read< SpriteData >("spr0");
 
 	//actually create Sprite objects from the data and insert into the lookup table:
 
@@ -0,0 +1,193 @@
+#include "UniformBlocks.hpp"
+
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+std::string const FrameBlockGLSL =
+	"struct FrameLight {\n"
+	"	vec3 LOCATION;\n"
+	"	int TYPE; //0: point, 1: hemisphere, 2: spot, 3: directional\n"
+	"	vec3 DIRECTION;\n"
+	"	float CUTOFF;\n"
+	"	vec3 ENERGY;\n"
+	"	float PADDING_;\n"
+	"};\n"
+	"layout(std140) uniform Frame {\n"
+	"	mat4 WORLD_TO_CLIP;\n"
+	"	vec3 EYE;\n"
+	"	uint LIGHTS;\n"
+	"	FrameLight LIGHT[" + std::to_string(FrameBlock::MaxLights) + "];\n"
+	"};\n"
+;
+
+std::string const ObjectBlockGLSL =
+	"layout(std140) uniform Object {\n"
+	"	mat4 OBJECT_TO_CLIP;\n"
+	"	mat4x3 OBJECT_TO_LIGHT;\n"
+	"	mat3 NORMAL_TO_LIGHT;\n"
+	"};\n"
+;
+
+void FrameBlock::set_light(uint32_t index, Scene::Light const &light_) {
+	assert(index < MaxLights);
+	Light &out = light[index];
+
+	glm::mat4x3 light_to_world = light_.transform->get_local_to_world();
+	out.location = light_to_world[3];
+	out.direction = -light_to_world[2];
+	out.energy = light_.energy;
+
+	if (light_.type == Scene::Light::Point) {
+		out.type = 0;
+		out.cutoff = 1.0f;
+	} else if (light_.type == Scene::Light::Hemisphere) {
+		out.type = 1;
+		out.cutoff = 1.0f;
+	} else if (light_.type == Scene::Light::Spot) {
+		out.type = 2;
+		out.cutoff = std::cos(0.5f * light_.spot_fov);
+	} else if (light_.type == Scene::Light::Directional) {
+		out.type = 3;
+		out.cutoff = 1.0f;
+	}
+}
+
+void ObjectBlock::set(glm::mat4 const &object_to_clip_, glm::mat4x3 const &object_to_light_, glm::mat3 const &normal_to_light_) {
+	object_to_clip = object_to_clip_;
+	for (uint32_t c = 0; c < 4; ++c) {
+		object_to_light[c] = glm::vec4(object_to_light_[c], 0.0f);
+	}
+	for (uint32_t c = 0; c < 3; ++c) {
+		normal_to_light[c] = glm::vec4(normal_to_light_[c], 0.0f);
+	}
+}
+
+void bind_uniform_blocks(GLuint program) {
+	GLuint frame_index = glGetUniformBlockIndex(program, "Frame");
+	if (frame_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, frame_index, FrameBlockBinding);
+	}
+	GLuint object_index = glGetUniformBlockIndex(program, "Object");
+	if (object_index != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, object_index, ObjectBlockBinding);
+	}
+	GL_ERRORS();
+}
+
+//------------------------------------------------------
+
+UniformRing::UniformRing() {
+	GLint align = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	if (align > 0) alignment = size_t(align);
+
+	size = 1 << 20;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	GL_ERRORS();
+}
+
+UniformRing::~UniformRing() {
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+}
+
+void UniformRing::reserve(size_t bytes) {
+	if (head + bytes <= size) return;
+
+	//out of room: start over in fresh (orphaned) storage, growing it if needed;
+	// draws already issued keep reading the old storage:
+	size_t needed = aligned(persistent_block_size) + bytes;
+	while (needed > size) size *= 2;
+	glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	head = 0;
+
+	//the persistent block was orphaned along with everything else, so put it back:
+	if (!persistent.empty()) {
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, persistent.size(), persistent.data());
+		glBindBufferRange(GL_UNIFORM_BUFFER, persistent_binding, buffer, 0, persistent_block_size);
+		head = aligned(persistent_block_size);
+	}
+}
+
+void UniformRing::upload(void const *data, size_t block_size, size_t count, std::vector< GLintptr > *offsets_) {
+	assert(offsets_);
+	auto &offsets = *offsets_;
+	if (count == 0) return;
+
+	size_t stride = aligned(block_size);
+	size_t total = stride * count;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	reserve(total);
+
+	GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+	char *dst = reinterpret_cast< char * >(glMapBufferRange(GL_UNIFORM_BUFFER, head, total, access));
+	if (!dst) throw std::runtime_error("Failed to map uniform ring buffer.");
+	char const *src = reinterpret_cast< char const * >(data);
+	for (size_t i = 0; i < count; ++i) {
+		std::memcpy(dst + i * stride, src + i * block_size, block_size);
+		offsets.emplace_back(GLintptr(head + i * stride));
+	}
+	glUnmapBuffer(GL_UNIFORM_BUFFER);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	head += total;
+
+	GL_ERRORS();
+}
+
+GLintptr UniformRing::upload(void const *data, size_t data_size, size_t block_size) {
+	assert(data_size <= block_size);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	reserve(block_size);
+
+	//(small blocks are cheaper to hand to the driver than to map)
+	GLintptr offset = GLintptr(head);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, data_size, data);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	head += aligned(block_size);
+
+	GL_ERRORS();
+
+	return offset;
+}
+
+void UniformRing::set_persistent(GLuint binding, void const *data, size_t data_size, size_t block_size) {
+	//(no longer needs to survive a wrap, since it is about to be replaced)
+	persistent.clear();
+	persistent_block_size = 0;
+
+	GLintptr offset = upload(data, data_size, block_size);
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, block_size);
+
+	//(assign() reuses the vector's storage once it is big enough)
+	char const *src = reinterpret_cast< char const * >(data);
+	persistent.assign(src, src + data_size);
+	persistent_binding = binding;
+	persistent_block_size = block_size;
+}
+
+UniformRing &uniform_ring() {
+	static UniformRing *ring = new UniformRing(); //(never deleted, since GL context may be gone by static destruction time)
+	return *ring;
+}
+
+void set_frame_block(FrameBlock const &frame) {
+	//only the lights in use are uploaded, but the whole block is bound (programs declare all MaxLights):
+	uint32_t lights = std::min(frame.lights, uint32_t(FrameBlock::MaxLights));
+	size_t used = offsetof(FrameBlock, light) + lights * sizeof(FrameBlock::Light);
+	uniform_ring().set_persistent(FrameBlockBinding, &frame, used, sizeof(FrameBlock));
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * Uniform buffer blocks shared between shader programs.
+ *
+ * "Frame" holds per-frame data (camera and lights); programs declare it with FrameBlockGLSL.
+ * "Object" holds per-drawable matrices; programs declare it with ObjectBlockGLSL,
+ *   and Scene::draw() fills it for any drawable whose pipeline sets 'object_block'.
+ *
+ * Block contents are streamed through a ring buffer (UniformRing) and attached to
+ *  their (fixed) binding points with glBindBufferRange.
+ *
+ */
+
+#include "GL.hpp"
+#include "Scene.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//binding points used by the shared blocks:
+enum : GLuint {
+	FrameBlockBinding = 0,
+	ObjectBlockBinding = 1,
+};
+
+//C++ mirror of the std140 "Frame" block:
+struct FrameBlock {
+	enum : uint32_t { MaxLights = 40 };
+
+	glm::mat4 world_to_clip = glm::mat4(1.0f);
+	glm::vec3 eye = glm::vec3(0.0f); //camera position in lighting space
+	uint32_t lights = 0; //number of entries of 'light' in use
+
+	struct Light {
+		glm::vec3 location = glm::vec3(0.0f);
+		int32_t type = 0; //0: point, 1: hemisphere, 2: spot, 3: directional
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+		float cutoff = 1.0f; //cosine of spot light half-angle
+		glm::vec3 energy = glm::vec3(0.0f);
+		float padding_ = 0.0f;
+	} light[MaxLights];
+
+	//set light[index] from a scene light:
+	void set_light(uint32_t index, Scene::Light const &light);
+};
+static_assert(sizeof(FrameBlock::Light) == 48, "FrameBlock::Light should match std140 layout.");
+static_assert(sizeof(FrameBlock) == 80 + 48 * FrameBlock::MaxLights, "FrameBlock should match std140 layout.");
+static_assert(offsetof(FrameBlock, light) == 80, "FrameBlock lights should follow the 80-byte header.");
+
+//C++ mirror of the std140 "Object" block:
+// (std140 pads each matrix column to a vec4)
+struct ObjectBlock {
+	glm::mat4 object_to_clip;
+	glm::vec4 object_to_light[4]; //columns of mat4x3 (.xyz)
+	glm::vec4 normal_to_light[3]; //columns of mat3 (.xyz)
+
+	void set(glm::mat4 const &object_to_clip, glm::mat4x3 const &object_to_light, glm::mat3 const &normal_to_light);
+};
+static_assert(sizeof(ObjectBlock) == 176, "ObjectBlock should match std140 layout.");
+
+//GLSL declarations of the blocks (include after #version):
+extern std::string const FrameBlockGLSL; //WORLD_TO_CLIP, EYE, LIGHTS, LIGHT[] (with .LOCATION, .TYPE, .DIRECTION, .CUTOFF, .ENERGY)
+extern std::string const ObjectBlockGLSL; //OBJECT_TO_CLIP, OBJECT_TO_LIGHT, NORMAL_TO_LIGHT
+
+//attach a program's Frame and/or Object blocks (if it has them) to their binding points:
+void bind_uniform_blocks(GLuint program);
+
+//Streaming buffer for uniform block data:
+// data is written sequentially; when the end is reached the buffer is orphaned and writing starts over
+// (so the persistent block, if any, is re-uploaded and re-bound after every wrap)
+struct UniformRing {
+	UniformRing();
+	~UniformRing();
+
+	//copy 'count' blocks of 'block_size' bytes to the ring, appending each block's offset to *offsets:
+	void upload(void const *data, size_t block_size, size_t count, std::vector< GLintptr > *offsets);
+
+	//copy one block of 'data_size' bytes to the ring, with room for 'block_size' bytes (>= data_size); returns its offset:
+	GLintptr upload(void const *data, size_t data_size, size_t block_size);
+
+	//upload a block that stays bound to 'binding' (with 'block_size' bytes of range) until the next set_persistent() call,
+	// even if later uploads wrap the ring (used for the Frame block, which stays bound while Scene::draw uploads Object blocks):
+	void set_persistent(GLuint binding, void const *data, size_t data_size, size_t block_size);
+
+	GLuint buffer = 0;
+	size_t size = 0; //allocated size of buffer
+	size_t head = 0; //next free byte
+	size_t alignment = 256; //GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+
+	//persistent block, kept for re-uploading after a wrap:
+	std::vector< char > persistent;
+	GLuint persistent_binding = 0;
+	size_t persistent_block_size = 0;
+
+	//make room for 'bytes' at 'head', orphaning (and, if needed, growing) the buffer if there isn't enough:
+	// (buffer must be bound to GL_UNIFORM_BUFFER)
+	void reserve(size_t bytes);
+	size_t aligned(size_t bytes) const { return (bytes + alignment - 1) / alignment * alignment; }
+};
+
+//the ring used by Scene and set_frame_block (created on first use):
+UniformRing &uniform_ring();
+
+//upload 'frame' (only its first frame.lights lights) and bind it to FrameBlockBinding:
+void set_frame_block(FrameBlock const &frame);
@@ -0,0 +1,79 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+WorkerPool::WorkerPool(uint32_t threads) : next_job(0) {
+	if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+	workers.reserve(threads - 1);
+	for (uint32_t i = 0; i + 1 < threads; ++i) {
+		workers.emplace_back([this]() {
+			uint32_t seen = 0;
+			while (true) {
+				{ //wait for a new run (or for the pool to shut down):
+					std::unique_lock< std::mutex > lock(mutex);
+					wake.wait(lock, [&]() { return quit || generation != seen; });
+					if (quit) return;
+					seen = generation;
+				}
+				work();
+				{
+					std::unique_lock< std::mutex > lock(mutex);
+					busy -= 1;
+				}
+				done.notify_one();
+			}
+		});
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void WorkerPool::work() {
+	while (true) {
+		uint32_t job = next_job.fetch_add(1);
+		if (job >= job_count) break;
+		(*job_fn)(job);
+	}
+}
+
+void WorkerPool::run(uint32_t jobs, std::function< void(uint32_t) > const &fn) {
+	if (jobs == 0) return;
+
+	//no point waking workers for a single job:
+	if (workers.empty() || jobs == 1) {
+		for (uint32_t job = 0; job < jobs; ++job) {
+			fn(job);
+		}
+		return;
+	}
+
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		assert(busy == 0 && "WorkerPool::run is not re-entrant");
+		job_fn = &fn;
+		job_count = jobs;
+		next_job = 0;
+		busy = uint32_t(workers.size());
+		generation += 1;
+	}
+	wake.notify_all();
+
+	//the calling thread helps too:
+	work();
+
+	{ //wait for workers to finish their last jobs:
+		std::unique_lock< std::mutex > lock(mutex);
+		done.wait(lock, [&]() { return busy == 0; });
+		job_fn = nullptr;
+	}
+}
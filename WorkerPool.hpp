@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * WorkerPool keeps a few threads around to split up loops whose iterations
+ *  don't depend on each other (e.g., narrow-phase collision tests).
+ *
+ * run(jobs, fn) calls fn(job) for every job in [0, jobs), spread over the
+ *  worker threads and the calling thread, and returns once all are done.
+ *  Jobs are handed out in no particular order, so callers that need
+ *  repeatable results should have each job write to its own output slot
+ *  and combine the slots afterward.
+ *
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerPool {
+	//'threads' is the total number of threads that run jobs, including the caller of run():
+	// (0 means one per hardware thread)
+	WorkerPool(uint32_t threads = 0);
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	//number of threads that run jobs (workers + caller):
+	uint32_t size() const { return uint32_t(workers.size()) + 1; }
+
+	//call fn(job) for each job in [0, jobs); returns when all calls have returned:
+	// (not re-entrant -- don't call run() from inside a job)
+	void run(uint32_t jobs, std::function< void(uint32_t) > const &fn);
+
+	//-- internals --
+	std::vector< std::thread > workers;
+
+	std::mutex mutex;
+	std::condition_variable wake; //signals workers that a run started (or quit was set)
+	std::condition_variable done; //signals run() that a worker finished
+	uint32_t generation = 0; //incremented every run()
+	uint32_t busy = 0; //workers still working on the current run()
+	bool quit = false;
+
+	std::function< void(uint32_t) > const *job_fn = nullptr;
+	uint32_t job_count = 0;
+	std::atomic< uint32_t > next_job;
+
+	void work(); //take jobs until none are left
+};
@@ -0,0 +1,551 @@
+#include "collide.hpp"
+#include "SpatialHash.hpp"
+#include "CollisionWorld.hpp"
+#include "WorkerPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdint>
+
+/*
+ * collide-bench runs collision code on randomized inputs, checks that
+ *  different ways of computing the same thing agree, and reports timings:
+ *  - "packet": collide_swept_sphere_vs_triangle (one triangle at a time) vs
+ *    collide_swept_sphere_vs_triangles (a packet at a time), bit-for-bit
+ *  - "soup": sweeps and rays through a random triangle soup, tested against
+ *    every triangle, every packet, and with CollisionMesh's hierarchy
+ *  - "hash": overlapping sphere pairs from SpatialHash vs checking every pair
+ *  - "threads": CollisionWorld::collide on one thread vs several, bit-for-bit
+ *
+ * Exits with a nonzero status if any results differ, so it can be run as a
+ *  check before (and after) changing collision code.
+ *
+ */
+
+//one randomized query:
+struct SweepCase {
+	glm::vec3 from, to;
+	float radius;
+	bool limit_t; //pass collision_t (starting at 't') or not
+	float t;
+	CollideTrianglePacket triangles;
+};
+
+//result of a query, compared bitwise:
+struct SweepResult {
+	uint32_t hit = -1U;
+	float t = 0.0f;
+	glm::vec3 at = glm::vec3(0.0f);
+	glm::vec3 out = glm::vec3(0.0f);
+};
+
+static bool same_bits(SweepResult const &a, SweepResult const &b) {
+	return a.hit == b.hit
+		&& std::memcmp(&a.t, &b.t, sizeof(float)) == 0
+		&& std::memcmp(&a.at, &b.at, sizeof(glm::vec3)) == 0
+		&& std::memcmp(&a.out, &b.out, sizeof(glm::vec3)) == 0;
+}
+
+static std::vector< SweepCase > make_cases(uint32_t count, uint32_t seed) {
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+	auto rand_vec3 = [&]() {
+		float x = unit(mt);
+		float y = unit(mt);
+		float z = unit(mt);
+		return glm::vec3(x, y, z);
+	};
+
+	std::vector< SweepCase > cases;
+	cases.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		SweepCase c;
+		//every so often use far-from-origin coordinates to stress rounding:
+		float scale = (i % 7 == 0 ? 1000.0f : 1.0f);
+		c.from = rand_vec3() * scale;
+		c.to = (i % 11 == 0 ? c.from : c.from + rand_vec3() * (i % 3 == 0 ? 2.0f : 0.5f));
+		c.radius = (i % 13 == 0 ? 0.0f : 0.5f * std::abs(unit(mt)));
+		c.limit_t = (i % 4 != 0);
+		c.t = (i % 9 == 0 ? 0.3f : (i % 10 == 0 ? 5.0f : 1.0f));
+
+		c.triangles.count = 1 + mt() % CollideTrianglePacket::Size;
+		for (uint32_t t = 0; t < CollideTrianglePacket::Size; ++t) {
+			glm::vec3 center = c.from + rand_vec3() * (i % 5 == 0 ? 3.0f : 1.0f);
+			float size = (i % 17 == 0 ? 100.0f : 0.7f);
+			glm::vec3 a = center + rand_vec3() * size;
+			glm::vec3 b = center + rand_vec3() * size;
+			glm::vec3 d = center + rand_vec3() * size;
+			if (i % 19 == 0) d = a + 0.5f * (b - a) + glm::vec3(1e-5f, 0.0f, 0.0f); //sliver
+			if (i % 23 == 0) d = b; //degenerate
+			if (i % 29 == 0) a.y = b.y = d.y = c.from.y - c.radius - 1e-6f; //grazing
+			c.triangles.set(t, a, b, d);
+		}
+		cases.emplace_back(c);
+	}
+	return cases;
+}
+
+static SweepResult run_scalar(SweepCase const &c) {
+	SweepResult r;
+	//(a local time limit starting at 2.0 matches what the packet version does without collision_t)
+	r.t = (c.limit_t ? c.t : 2.0f);
+	CollideTrianglePacket const &p = c.triangles;
+	for (uint32_t i = 0; i < p.count; ++i) {
+		if (collide_swept_sphere_vs_triangle(c.from, c.to, c.radius,
+			glm::vec3(p.ax[i], p.ay[i], p.az[i]),
+			glm::vec3(p.bx[i], p.by[i], p.bz[i]),
+			glm::vec3(p.cx[i], p.cy[i], p.cz[i]),
+			&r.t, &r.at, &r.out)) {
+			r.hit = i;
+		}
+	}
+	if (!c.limit_t || r.hit == -1U) r.t = c.t;
+	return r;
+}
+
+static SweepResult run_packet(SweepCase const &c) {
+	SweepResult r;
+	r.t = c.t;
+	r.hit = collide_swept_sphere_vs_triangles(c.from, c.to, c.radius, c.triangles,
+		(c.limit_t ? &r.t : nullptr), &r.at, &r.out);
+	return r;
+}
+
+//helper: seconds since 'before':
+static double seconds_since(std::chrono::high_resolution_clock::time_point const &before) {
+	return std::chrono::duration< double >(std::chrono::high_resolution_clock::now() - before).count();
+}
+
+//------------------------------------------------------
+//"packet": collide_swept_sphere_vs_triangle vs collide_swept_sphere_vs_triangles
+
+static bool bench_packet(uint32_t count, uint32_t seed) {
+	std::cout << "--- packet: swept sphere vs triangle, one at a time and as packets ---" << std::endl;
+
+	std::vector< SweepCase > cases = make_cases(count, seed);
+	std::vector< SweepResult > scalar_results(cases.size());
+	std::vector< SweepResult > packet_results(cases.size());
+
+	uint64_t triangle_count = 0;
+	for (auto const &c : cases) triangle_count += c.triangles.count;
+
+	auto time = [&](char const *name, SweepResult (*run)(SweepCase const &), std::vector< SweepResult > &results) {
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < cases.size(); ++i) {
+			results[i] = run(cases[i]);
+		}
+		double seconds = seconds_since(before);
+		std::cout << name << ": " << (seconds * 1e9 / double(cases.size())) << " ns/query, "
+		          << (double(triangle_count) / seconds) << " triangle tests/sec" << std::endl;
+	};
+
+	time("scalar", run_scalar, scalar_results);
+	time("packet", run_packet, packet_results);
+
+	uint32_t hits = 0;
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < cases.size(); ++i) {
+		if (scalar_results[i].hit != -1U) ++hits;
+		if (!same_bits(scalar_results[i], packet_results[i])) {
+			if (mismatches < 10) {
+				std::cerr << "MISMATCH on query " << i << ": scalar hit " << int32_t(scalar_results[i].hit) << " at t = " << scalar_results[i].t
+				          << ", packet hit " << int32_t(packet_results[i].hit) << " at t = " << packet_results[i].t << std::endl;
+			}
+			++mismatches;
+		}
+	}
+	std::cout << cases.size() << " queries (" << triangle_count << " triangles), " << hits << " hits, " << mismatches << " mismatches." << std::endl;
+
+	return mismatches == 0;
+}
+
+//------------------------------------------------------
+//"soup": sweeps and rays through a triangle soup -- every triangle (one at a time / packets) vs CollisionMesh
+
+static bool bench_soup(uint32_t triangle_count, uint32_t query_count, uint32_t seed) {
+	std::cout << "--- soup: " << query_count << " sweeps and rays through " << triangle_count << " random triangles ---" << std::endl;
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+	auto rand_vec3 = [&]() {
+		float x = unit(mt);
+		float y = unit(mt);
+		float z = unit(mt);
+		return glm::vec3(x, y, z);
+	};
+
+	//triangles about a unit across, scattered through a cube sized for ~1 triangle per 8 cubic units:
+	float side = std::cbrt(8.0f * float(triangle_count));
+	std::vector< glm::vec3 > positions;
+	std::vector< uint32_t > corners;
+	positions.reserve(3 * triangle_count);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		glm::vec3 center = 0.5f * side * rand_vec3();
+		for (uint32_t i = 0; i < 3; ++i) {
+			corners.emplace_back(uint32_t(positions.size()));
+			positions.emplace_back(center + 0.7f * rand_vec3());
+		}
+	}
+
+	//packets of the same triangles:
+	std::vector< CollideTrianglePacket > packets((triangle_count + CollideTrianglePacket::Size - 1) / CollideTrianglePacket::Size);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		CollideTrianglePacket &packet = packets[t / CollideTrianglePacket::Size];
+		packet.set(t % CollideTrianglePacket::Size, positions[3*t+0], positions[3*t+1], positions[3*t+2]);
+		packet.count = t % CollideTrianglePacket::Size + 1;
+	}
+
+	auto before = std::chrono::high_resolution_clock::now();
+	CollisionMesh mesh(positions, corners);
+	std::cout << "CollisionMesh build: " << (seconds_since(before) * 1e3) << " ms (" << mesh.nodes.size() << " nodes)" << std::endl;
+
+	//queries of various lengths and radii, starting inside the cube:
+	struct Query {
+		glm::vec3 from, to;
+		float radius;
+	};
+	std::vector< Query > queries;
+	queries.reserve(query_count);
+	for (uint32_t q = 0; q < query_count; ++q) {
+		Query query;
+		query.from = 0.5f * side * rand_vec3();
+		query.to = query.from + (q % 2 ? 0.1f * side : 2.0f) * rand_vec3();
+		query.radius = (q % 5 == 0 ? 0.0f : 0.5f * std::abs(unit(mt)));
+		queries.emplace_back(query);
+	}
+
+	//every implementation fills in one of these per query:
+	struct Hit {
+		bool hit = false;
+		float t = 1.0f;
+		glm::vec3 at = glm::vec3(0.0f);
+		glm::vec3 out = glm::vec3(0.0f);
+	};
+
+	auto report = [&](char const *name, double seconds, uint64_t tests) {
+		std::cout << name << ": " << (seconds * 1e9 / double(queries.size())) << " ns/query";
+		if (tests) std::cout << ", " << (double(tests) / seconds) << " triangle tests/sec";
+		std::cout << std::endl;
+	};
+
+	uint64_t all_tests = uint64_t(triangle_count) * uint64_t(queries.size());
+
+	//swept spheres:
+	std::vector< Hit > scalar(queries.size()), packet(queries.size()), bvh(queries.size());
+
+	before = std::chrono::high_resolution_clock::now();
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		Query const &query = queries[q];
+		Hit &hit = scalar[q];
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			if (collide_swept_sphere_vs_triangle(query.from, query.to, query.radius,
+				positions[3*t+0], positions[3*t+1], positions[3*t+2],
+				&hit.t, &hit.at, &hit.out)) hit.hit = true;
+		}
+	}
+	report("sweep, every triangle", seconds_since(before), all_tests);
+
+	before = std::chrono::high_resolution_clock::now();
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		Query const &query = queries[q];
+		Hit &hit = packet[q];
+		for (auto const &p : packets) {
+			if (collide_swept_sphere_vs_triangles(query.from, query.to, query.radius, p, &hit.t, &hit.at, &hit.out) != -1U) hit.hit = true;
+		}
+	}
+	report("sweep, every packet", seconds_since(before), all_tests);
+
+	before = std::chrono::high_resolution_clock::now();
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		Query const &query = queries[q];
+		Hit &hit = bvh[q];
+		hit.hit = mesh.sweep_sphere(query.from, query.to, query.radius, &hit.t, &hit.at, &hit.out);
+	}
+	report("sweep, CollisionMesh", seconds_since(before), 0);
+
+	//rays (reusing the sweeps' segments):
+	std::vector< Hit > ray_scalar(queries.size()), ray_bvh(queries.size());
+
+	before = std::chrono::high_resolution_clock::now();
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		Query const &query = queries[q];
+		Hit &hit = ray_scalar[q];
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			if (collide_ray_vs_triangle(query.from, query.to - query.from,
+				positions[3*t+0], positions[3*t+1], positions[3*t+2],
+				&hit.t, &hit.at, &hit.out)) hit.hit = true;
+		}
+	}
+	report("ray, every triangle", seconds_since(before), all_tests);
+
+	before = std::chrono::high_resolution_clock::now();
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		Query const &query = queries[q];
+		Hit &hit = ray_bvh[q];
+		hit.hit = mesh.ray(query.from, query.to - query.from, &hit.t, &hit.at, &hit.out);
+	}
+	report("ray, CollisionMesh", seconds_since(before), 0);
+
+	//cross-check:
+	// - packets test triangles in the same order as the scalar loop, so must match exactly;
+	// - CollisionMesh tests them in a different order, so only the time of the first hit must match
+	//   (when several triangles are hit at exactly the same time, 'at' and 'out' may come from any of them)
+	auto same_float = [](float a, float b) {
+		return std::memcmp(&a, &b, sizeof(float)) == 0;
+	};
+	auto exact = [&](Hit const &a, Hit const &b) {
+		return a.hit == b.hit && same_float(a.t, b.t)
+			&& std::memcmp(&a.at, &b.at, sizeof(glm::vec3)) == 0
+			&& std::memcmp(&a.out, &b.out, sizeof(glm::vec3)) == 0;
+	};
+	auto same_time = [&](Hit const &a, Hit const &b) {
+		return a.hit == b.hit && (!a.hit || same_float(a.t, b.t));
+	};
+
+	uint32_t hits = 0, ray_hits = 0;
+	uint32_t packet_mismatches = 0, bvh_mismatches = 0, ray_mismatches = 0;
+	for (uint32_t q = 0; q < queries.size(); ++q) {
+		if (scalar[q].hit) ++hits;
+		if (ray_scalar[q].hit) ++ray_hits;
+		if (!exact(scalar[q], packet[q])) {
+			if (packet_mismatches < 10) std::cerr << "MISMATCH (packet) on sweep " << q << ": t = " << scalar[q].t << " vs " << packet[q].t << std::endl;
+			++packet_mismatches;
+		}
+		if (!same_time(scalar[q], bvh[q])) {
+			if (bvh_mismatches < 10) std::cerr << "MISMATCH (CollisionMesh) on sweep " << q << ": t = " << scalar[q].t << " vs " << bvh[q].t << std::endl;
+			++bvh_mismatches;
+		}
+		if (!same_time(ray_scalar[q], ray_bvh[q])) {
+			if (ray_mismatches < 10) std::cerr << "MISMATCH (CollisionMesh) on ray " << q << ": t = " << ray_scalar[q].t << " vs " << ray_bvh[q].t << std::endl;
+			++ray_mismatches;
+		}
+	}
+	std::cout << hits << " sweeps and " << ray_hits << " rays hit; mismatches: "
+	          << packet_mismatches << " packet, " << bvh_mismatches << " CollisionMesh sweep, " << ray_mismatches << " CollisionMesh ray." << std::endl;
+
+	return packet_mismatches == 0 && bvh_mismatches == 0 && ray_mismatches == 0;
+}
+
+//------------------------------------------------------
+//"hash": SpatialHash::for_each_pair vs checking every pair
+
+typedef std::pair< uint32_t, uint32_t > IdPair;
+
+static bool bench_hash(uint32_t seed) {
+	std::cout << "--- hash: overlapping sphere pairs, spatial hash and brute force ---" << std::endl;
+
+	bool ok = true;
+	for (uint32_t count : {1000U, 10000U, 100000U}) {
+		//spheres of radius [0.25,0.5] with, on average, eight units of volume each:
+		std::mt19937 mt(seed + count);
+		float side = 2.0f * std::cbrt(float(count));
+		std::uniform_real_distribution< float > coord(0.0f, side);
+		std::uniform_real_distribution< float > radius(0.25f, 0.5f);
+		std::vector< glm::vec3 > centers;
+		std::vector< float > radii;
+		centers.reserve(count);
+		radii.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			float x = coord(mt);
+			float y = coord(mt);
+			float z = coord(mt);
+			centers.emplace_back(x, y, z);
+			radii.emplace_back(radius(mt));
+		}
+
+		//spatial hash (average over several rebuilds, as if every frame):
+		std::vector< IdPair > hash_pairs;
+		SpatialHash hash(1.0f);
+		uint32_t const Frames = 10;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 0; frame < Frames; ++frame) {
+			hash_pairs.clear();
+			hash.build(centers, radii);
+			hash.for_each_pair([&](uint32_t a, uint32_t b) {
+				hash_pairs.emplace_back(std::min(a, b), std::max(a, b));
+			});
+		}
+		double hash_seconds = seconds_since(before) / Frames;
+
+		//brute force:
+		std::vector< IdPair > brute_pairs;
+		before = std::chrono::high_resolution_clock::now();
+		for (uint32_t a = 0; a < count; ++a) {
+			for (uint32_t b = a + 1; b < count; ++b) {
+				if (collide_sphere_vs_sphere(centers[a], radii[a], centers[b], radii[b])) {
+					brute_pairs.emplace_back(a, b);
+				}
+			}
+		}
+		double brute_seconds = seconds_since(before);
+
+		std::sort(hash_pairs.begin(), hash_pairs.end());
+		std::sort(brute_pairs.begin(), brute_pairs.end());
+		bool same = (hash_pairs == brute_pairs);
+		if (!same) {
+			std::cerr << "MISMATCH with " << count << " spheres: hash found " << hash_pairs.size() << " pairs, brute force found " << brute_pairs.size() << "." << std::endl;
+			ok = false;
+		}
+
+		std::cout << count << " spheres, " << brute_pairs.size() << " pairs: "
+		          << "hash " << (hash_seconds * 1e3) << " ms, "
+		          << "brute force " << (brute_seconds * 1e3) << " ms "
+		          << "(" << (brute_seconds / hash_seconds) << "x)" << (same ? "" : " MISMATCH") << std::endl;
+	}
+	return ok;
+}
+
+//------------------------------------------------------
+//"threads": CollisionWorld::collide with WorkerPools of different sizes
+
+static bool bench_threads(uint32_t seed) {
+	std::cout << "--- threads: CollisionWorld narrow phase on 1 to " << std::max(1U, std::thread::hardware_concurrency()) << " threads ---" << std::endl;
+
+	std::mt19937 mt(seed);
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+
+	//bumpy floor, 64x64 units:
+	uint32_t const Grid = 64;
+	std::vector< glm::vec3 > positions;
+	std::vector< uint32_t > corners;
+	for (uint32_t y = 0; y <= Grid; ++y) {
+		for (uint32_t x = 0; x <= Grid; ++x) {
+			positions.emplace_back(float(x) - 0.5f * Grid, 0.25f * unit(mt), float(y) - 0.5f * Grid);
+		}
+	}
+	for (uint32_t y = 0; y < Grid; ++y) {
+		for (uint32_t x = 0; x < Grid; ++x) {
+			uint32_t i = y * (Grid + 1) + x;
+			for (uint32_t c : {i, i + Grid + 1, i + 1, i + 1, i + Grid + 1, i + Grid + 2}) {
+				corners.emplace_back(c);
+			}
+		}
+	}
+	CollisionMesh floor(positions, corners);
+
+	//lots of balls and capsules just above it:
+	CollisionWorld world;
+	std::list< Scene::Transform > transforms;
+	transforms.emplace_back();
+	world.add_mesh(&transforms.back(), &floor);
+	uint32_t const Bodies = 4000;
+	for (uint32_t i = 0; i < Bodies; ++i) {
+		transforms.emplace_back();
+		Scene::Transform &transform = transforms.back();
+		transform.position = glm::vec3(30.0f * unit(mt), 1.0f + 0.8f * unit(mt), 30.0f * unit(mt));
+		if (i % 2) world.add_sphere(&transform, 0.4f);
+		else world.add_capsule(&transform, glm::vec3(-0.3f, 0.0f, 0.0f), glm::vec3(0.3f, 0.0f, 0.0f), 0.3f);
+	}
+	world.update();
+	//move everything a bit (mostly down) and find candidate pairs:
+	for (auto &transform : transforms) {
+		if (&transform == &transforms.front()) continue;
+		transform.position += glm::vec3(0.5f * unit(mt), -0.7f + 0.5f * unit(mt), 0.5f * unit(mt));
+	}
+	world.update();
+
+	auto same_contacts = [](std::vector< CollisionWorld::Contact > const &a, std::vector< CollisionWorld::Contact > const &b) {
+		static_assert(sizeof(CollisionWorld::Contact) == 3 * 4 + 2 * 12 + 4, "Contact has no padding.");
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(CollisionWorld::Contact)) == 0);
+	};
+
+	uint32_t const Repeats = 20;
+	std::vector< CollisionWorld::Contact > reference;
+	world.collide(&reference);
+	std::cout << Bodies << " bodies, " << world.pairs.size() << " candidate pairs, " << reference.size() << " contacts." << std::endl;
+
+	std::vector< uint32_t > thread_counts;
+	uint32_t max_threads = std::max(1U, std::thread::hardware_concurrency());
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) thread_counts.emplace_back(threads);
+	thread_counts.emplace_back(max_threads);
+
+	bool ok = true;
+	double single_seconds = 0.0;
+	for (uint32_t threads : thread_counts) {
+		WorkerPool pool(threads);
+		std::vector< CollisionWorld::Contact > contacts;
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t r = 0; r < Repeats; ++r) {
+			contacts.clear();
+			world.collide(&contacts, &pool);
+		}
+		double seconds = seconds_since(before) / Repeats;
+		if (threads == 1) single_seconds = seconds;
+		bool same = same_contacts(contacts, reference);
+		if (!same) {
+			std::cerr << "MISMATCH with " << threads << " threads: " << contacts.size() << " contacts vs " << reference.size() << " on one thread." << std::endl;
+			ok = false;
+		}
+		std::cout << threads << " threads: " << (seconds * 1e3) << " ms (" << (single_seconds / seconds) << "x)" << (same ? "" : " MISMATCH") << std::endl;
+	}
+	return ok;
+}
+
+//------------------------------------------------------
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try { //windows doesn't print nice errors for unhandled exceptions, so we need to.
+#endif
+	std::vector< std::string > const Sections = { "packet", "soup", "hash", "threads" };
+
+	uint32_t queries = 1000000;
+	uint32_t triangles = 20000;
+	uint32_t sweeps = 1000;
+	uint32_t seed = 1;
+	std::vector< std::string > sections;
+	bool usage = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if ((arg == "--queries" || arg == "--triangles" || arg == "--sweeps" || arg == "--seed") && i + 1 < argc) {
+			std::istringstream str(argv[++i]);
+			uint32_t &value = (arg == "--queries" ? queries : arg == "--triangles" ? triangles : arg == "--sweeps" ? sweeps : seed);
+			char temp;
+			if (!(str >> value) || (str >> temp)) {
+				std::cerr << "ERROR: failed to parse number from \"" << argv[i] << "\"." << std::endl;
+				return 1;
+			}
+		} else if (std::find(Sections.begin(), Sections.end(), arg) != Sections.end()) {
+			sections.emplace_back(arg);
+		} else {
+			usage = true;
+		}
+	}
+	if (usage) {
+		std::cerr << "Usage:\n\t./collide-bench [--queries N] [--triangles N] [--sweeps N] [--seed N] [packet] [soup] [hash] [threads]\n";
+		std::cerr << " cross-checks and times collision tests on randomized inputs (all sections if none are named):\n";
+		std::cerr << "  packet -- swept sphere vs triangle, one at a time and as packets, on N (default: 1000000) queries\n";
+		std::cerr << "  soup -- --sweeps (default: 1000) swept spheres and rays through --triangles (default: 20000) random triangles, tested against every triangle, every packet, and with CollisionMesh\n";
+		std::cerr << "  hash -- overlapping pairs of 1k/10k/100k spheres with SpatialHash and by brute force\n";
+		std::cerr << "  threads -- CollisionWorld narrow phase (balls and capsules on a floor) with 1 to N worker threads\n";
+		std::cerr.flush();
+		return 1;
+	}
+	if (sections.empty()) sections = Sections;
+
+	bool ok = true;
+	for (auto const &section : sections) {
+		if (section == "packet") ok = bench_packet(queries, seed) && ok;
+		if (section == "soup") ok = bench_soup(triangles, sweeps, seed) && ok;
+		if (section == "hash") ok = bench_hash(seed) && ok;
+		if (section == "threads") ok = bench_threads(seed) && ok;
+	}
+
+	return (ok ? 0 : 1);
+#ifdef _WIN32
+	} catch (std::exception &e) {
+		std::cerr << "UNHANDLED EXCEPTION:\n" << e.what() << std::endl;
+		return 1;
+	}
+#endif
+}
@@ -1,6 +1,9 @@
 #include "collide.hpp"
+#include "Lanes.hpp"
 
 #include <initializer_list>
+#include <cassert>
+#include <cmath>
 #include <algorithm>
 #include <iostream>
 
@@ -21,6 +24,15 @@ bool collide_AABB_vs_AABB(
 	);
 }
 
+bool collide_sphere_vs_sphere(
+	glm::vec3 const &a_center, float a_radius,
+	glm::vec3 const &b_center, float b_radius
+) {
+	glm::vec3 to = b_center - a_center;
+	float r = a_radius + b_radius;
+	return glm::dot(to, to) <= r * r;
+}
+
 
 
 //helper: normalize but don't return NaN:
@@ -261,3 +273,160 @@ bool collide_swept_sphere_vs_triangle(
 
 	return collided;
 }
+
+bool collide_ray_vs_triangle(
+	glm::vec3 const &ray_start, glm::vec3 const &ray_direction,
+	glm::vec3 const &triangle_a, glm::vec3 const &triangle_b, glm::vec3 const &triangle_c,
+	float *collision_t, glm::vec3 *collision_at, glm::vec3 *collision_out
+) {
+	//METHOD: solve for barycentric coordinates (u,v) and time t ("Moller-Trumbore"):
+	glm::vec3 ab = triangle_b - triangle_a;
+	glm::vec3 ac = triangle_c - triangle_a;
+	glm::vec3 p = glm::cross(ray_direction, ac);
+	float det = glm::dot(ab, p);
+	if (det == 0.0f) return false; //ray parallel to (or triangle degenerate)
+
+	float inv_det = 1.0f / det;
+	glm::vec3 s = ray_start - triangle_a;
+	float u = glm::dot(s, p) * inv_det;
+	if (u < 0.0f || u > 1.0f) return false;
+
+	glm::vec3 q = glm::cross(s, ab);
+	float v = glm::dot(ray_direction, q) * inv_det;
+	if (v < 0.0f || u + v > 1.0f) return false;
+
+	float t = glm::dot(ac, q) * inv_det;
+	if (t < 0.0f) return false;
+	if (collision_t && t >= *collision_t) return false;
+
+	if (collision_t) *collision_t = t;
+	if (collision_at) *collision_at = ray_start + t * ray_direction;
+	if (collision_out) {
+		glm::vec3 normal = careful_normalize(glm::cross(ab, ac));
+		if (glm::dot(normal, ray_direction) > 0.0f) normal = -normal;
+		*collision_out = normal;
+	}
+	return true;
+}
+
+//------------------------------------------------------
+//Swept sphere vs triangle packet.
+//
+//The exact test is collide_swept_sphere_vs_triangle itself, so results match it bit-for-bit;
+// the SIMD part only rejects triangles that the sweep certainly can't touch:
+//  - triangles whose bounding box misses the (padded) bounding box of the sweep
+//  - triangles whose plane has the (padded) sweep entirely on one side
+// The padding is a little more than the radius to leave room for rounding in the exact test.
+
+static_assert(CollideTrianglePacket::Size % LaneCount == 0, "Packet is a whole number of lane groups.");
+
+//returns a bit for each triangle [first, first + LaneCount) that can't be rejected:
+static inline uint32_t packet_candidates(
+	CollideTrianglePacket const &triangles, uint32_t first,
+	glm::vec3 const &sweep_from, glm::vec3 const &sweep_to, float sweep_radius, float sweep_scale) {
+
+	Lanes ax = lanes_load(triangles.ax + first), ay = lanes_load(triangles.ay + first), az = lanes_load(triangles.az + first);
+	Lanes bx = lanes_load(triangles.bx + first), by = lanes_load(triangles.by + first), bz = lanes_load(triangles.bz + first);
+	Lanes cx = lanes_load(triangles.cx + first), cy = lanes_load(triangles.cy + first), cz = lanes_load(triangles.cz + first);
+
+	//padded radius, scaled with the magnitude of the coordinates involved:
+	Lanes scale = lanes_max(lanes_set(sweep_scale), lanes_max(
+		lanes_max(lanes_max(lanes_abs(ax), lanes_abs(ay)), lanes_abs(az)),
+		lanes_max(
+			lanes_max(lanes_max(lanes_abs(bx), lanes_abs(by)), lanes_abs(bz)),
+			lanes_max(lanes_max(lanes_abs(cx), lanes_abs(cy)), lanes_abs(cz))
+		)
+	));
+	Lanes pad = lanes_set(sweep_radius) + lanes_set(1e-4f) * (lanes_set(sweep_radius) + scale);
+
+	LaneMask reject;
+
+	{ //box test:
+		glm::vec3 sweep_min = glm::min(sweep_from, sweep_to);
+		glm::vec3 sweep_max = glm::max(sweep_from, sweep_to);
+		reject = lanes_or(
+			lanes_or(
+				lanes_lt(lanes_max(ax, lanes_max(bx, cx)) + pad, lanes_set(sweep_min.x)),
+				lanes_lt(lanes_max(ay, lanes_max(by, cy)) + pad, lanes_set(sweep_min.y))
+			),
+			lanes_or(
+				lanes_lt(lanes_max(az, lanes_max(bz, cz)) + pad, lanes_set(sweep_min.z)),
+				lanes_lt(lanes_set(sweep_max.x), lanes_min(ax, lanes_min(bx, cx)) - pad)
+			)
+		);
+		reject = lanes_or(reject, lanes_or(
+			lanes_lt(lanes_set(sweep_max.y), lanes_min(ay, lanes_min(by, cy)) - pad),
+			lanes_lt(lanes_set(sweep_max.z), lanes_min(az, lanes_min(bz, cz)) - pad)
+		));
+	}
+
+	{ //plane test:
+		Lanes e1x = bx - ax, e1y = by - ay, e1z = bz - az;
+		Lanes e2x = cx - ax, e2y = cy - ay, e2z = cz - az;
+		Lanes nx = e1y * e2z - e1z * e2y;
+		Lanes ny = e1z * e2x - e1x * e2z;
+		Lanes nz = e1x * e2y - e1y * e2x;
+		Lanes nn = nx * nx + ny * ny + nz * nz;
+
+		//(unnormalized) distances from plane to ends of sweep:
+		Lanes d0 = nx * (lanes_set(sweep_from.x) - ax) + ny * (lanes_set(sweep_from.y) - ay) + nz * (lanes_set(sweep_from.z) - az);
+		Lanes d1 = nx * (lanes_set(sweep_to.x) - ax) + ny * (lanes_set(sweep_to.y) - ay) + nz * (lanes_set(sweep_to.z) - az);
+		Lanes limit = pad * pad * nn;
+
+		//only trust the plane of triangles that aren't too sliver-like:
+		Lanes e1e1 = e1x * e1x + e1y * e1y + e1z * e1z;
+		Lanes e2e2 = e2x * e2x + e2y * e2y + e2z * e2z;
+		LaneMask trusted = lanes_lt(lanes_set(1e-4f) * e1e1 * e2e2, nn);
+
+		reject = lanes_or(reject, lanes_and(
+			lanes_and(trusted, lanes_lt(lanes_set(0.0f), d0 * d1)),
+			lanes_and(lanes_lt(limit, d0 * d0), lanes_lt(limit, d1 * d1))
+		));
+	}
+
+	return ~lanes_bits(reject) & ((1U << LaneCount) - 1U);
+}
+
+uint32_t collide_swept_sphere_vs_triangles(
+	glm::vec3 const &sphere_from, glm::vec3 const &sphere_to, float sphere_radius,
+	CollideTrianglePacket const &triangles,
+	float *collision_t, glm::vec3 *collision_at, glm::vec3 *collision_out
+) {
+	assert(triangles.count <= CollideTrianglePacket::Size);
+
+	//same time limit as collide_swept_sphere_vs_triangle:
+	float t = 2.0f;
+	if (collision_t) {
+		t = std::min(t, *collision_t);
+		if (t <= 0.0f) return -1U;
+	}
+
+	//no hit (interior, edge, or vertex) can happen after time t:
+	glm::vec3 sweep_to = sphere_from + t * (sphere_to - sphere_from);
+	float sweep_scale = std::max(
+		std::max(std::max(std::abs(sphere_from.x), std::abs(sphere_from.y)), std::abs(sphere_from.z)),
+		std::max(std::max(std::abs(sweep_to.x), std::abs(sweep_to.y)), std::abs(sweep_to.z))
+	);
+
+	uint32_t candidates = 0;
+	for (uint32_t first = 0; first < triangles.count; first += LaneCount) {
+		candidates |= packet_candidates(triangles, first, sphere_from, sweep_to, sphere_radius, sweep_scale) << first;
+	}
+	candidates &= (1U << triangles.count) - 1U;
+
+	//exact test on remaining triangles, in order:
+	uint32_t hit = -1U;
+	for (uint32_t i = 0; i < triangles.count; ++i) {
+		if (!(candidates & (1U << i))) continue;
+		if (collide_swept_sphere_vs_triangle(sphere_from, sphere_to, sphere_radius,
+			glm::vec3(triangles.ax[i], triangles.ay[i], triangles.az[i]),
+			glm::vec3(triangles.bx[i], triangles.by[i], triangles.bz[i]),
+			glm::vec3(triangles.cx[i], triangles.cy[i], triangles.cz[i]),
+			&t, collision_at, collision_out)) {
+			hit = i;
+		}
+	}
+
+	if (hit != -1U && collision_t) *collision_t = t;
+	return hit;
+}
@@ -11,6 +11,13 @@ bool collide_AABB_vs_AABB(
 	glm::vec3 const &b_min, glm::vec3 const &b_max
 );
 
+//Check if two spheres overlap:
+// (touching counts as overlapping)
+bool collide_sphere_vs_sphere(
+	glm::vec3 const &a_center, float a_radius,
+	glm::vec3 const &b_center, float b_radius
+);
+
 //Check a swept sphere vs a single triangle:
 // returns 'true' on collision
 bool collide_swept_sphere_vs_triangle(
@@ -27,3 +34,53 @@ bool collide_swept_sphere_vs_triangle(
 	glm::vec3 *collision_at = nullptr, //[optional,out] point where sphere touches triangle
 	glm::vec3 *collision_out = nullptr //[optional,out] direction to move sphere to get away from triangle as quickly as possible (basically, the outward normal)
 );
+
+//Check a ray vs a single triangle:
+// returns 'true' on collision
+bool collide_ray_vs_triangle(
+	//ray:
+	glm::vec3 const &ray_start,
+	glm::vec3 const &ray_direction,
+	//triangle:
+	glm::vec3 const &triangle_a,
+	glm::vec3 const &triangle_b,
+	glm::vec3 const &triangle_c,
+	//output:
+	float *collision_t = nullptr, //[optional,in+out] first time (in multiples of ray_direction) where ray hits triangle; if not given, any t >= 0 counts
+	glm::vec3 *collision_at = nullptr, //[optional,out] point where ray hits triangle
+	glm::vec3 *collision_out = nullptr //[optional,out] triangle normal, facing the ray's start
+);
+
+//Several triangles in structure-of-arrays layout, for testing against at once:
+// (arrays are aligned for SIMD loads, but packets needn't be -- heap allocations before C++17 may not honor alignas)
+struct CollideTrianglePacket {
+	enum : uint32_t { Size = 8 };
+	alignas(32) float ax[Size], ay[Size], az[Size];
+	alignas(32) float bx[Size], by[Size], bz[Size];
+	alignas(32) float cx[Size], cy[Size], cz[Size];
+	uint32_t count = 0; //triangles [0,count) are used
+
+	void set(uint32_t i, glm::vec3 const &a, glm::vec3 const &b, glm::vec3 const &c) {
+		ax[i] = a.x; ay[i] = a.y; az[i] = a.z;
+		bx[i] = b.x; by[i] = b.y; bz[i] = b.z;
+		cx[i] = c.x; cy[i] = c.y; cz[i] = c.z;
+	}
+};
+
+//Check a swept sphere vs the triangles in a packet:
+// returns index of the triangle with the earliest collision, or -1U if there is no collision
+// results (including outputs) are bit-for-bit the same as calling collide_swept_sphere_vs_triangle
+//  on triangles 0 .. count-1 in order, passing the same collision_t to each
+// (SIMD -- AVX or SSE, when available -- is used to cheaply reject triangles that can't be touched)
+uint32_t collide_swept_sphere_vs_triangles(
+	//swept sphere:
+	glm::vec3 const &sphere_from,
+	glm::vec3 const &sphere_to,
+	float sphere_radius,
+	//triangles:
+	CollideTrianglePacket const &triangles,
+	//output:
+	float *collision_t = nullptr, //[optional,in+out] first time where sphere touches a triangle
+	glm::vec3 *collision_at = nullptr, //[optional,out] point where sphere touches triangle
+	glm::vec3 *collision_out = nullptr //[optional,out] direction to move sphere to get away from triangle
+);
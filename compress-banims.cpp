@@ -0,0 +1,294 @@
+#include "read_write_chunk.hpp"
+#include "BoneAnimationTracks.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <cmath>
+
+/*
+ * compress the animations in a bone animation file (as written by
+ *  export-bone-animations.py) into the key-based tracks BoneAnimation reads
+ *  from 'trk0'/'ktm0'/'kvl0' chunks (see BoneAnimationTracks.hpp):
+ *  - each animation gets a position, rotation, and scale track per bone;
+ *  - tracks that stay within the error bound of their first frame are
+ *    stored as one key;
+ *  - other tracks get keys greedily: each key is placed as far after the
+ *    previous one as possible while every frame in between, interpolated
+ *    from the (packed) keys just like BoneAnimation samples them, stays
+ *    within the error bound.
+ * Frames outside of any animation are dropped.
+ *
+ * Errors are measured per track (positions and scales in their own units,
+ *  rotations in radians), so error can add up along chains of bones.
+ *
+ */
+
+struct PoseBone {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+};
+static_assert(sizeof(PoseBone) == 3*4 + 4*4 + 3*4, "PoseBone is packed.");
+
+struct BoneInfo {
+	uint32_t name_begin, name_end;
+	uint32_t parent;
+	glm::mat4x3 inverse_bind_matrix;
+};
+static_assert(sizeof(BoneInfo) == 4*2 + 4 + 4*12, "BoneInfo is packed.");
+
+struct AnimationInfo {
+	uint32_t name_begin, name_end;
+	uint32_t begin, end;
+};
+static_assert(sizeof(AnimationInfo) == 4*2 + 4*2, "AnimationInfo is packed.");
+
+//angle between two (unit) rotations:
+// (from the distance between the quaternions, which is 2 sin(angle/4); unlike acos of their dot product, this stays accurate for small angles)
+static float rotation_error(glm::quat const &a, glm::quat const &b) {
+	float s = (glm::dot(a, b) < 0.0f ? -1.0f : 1.0f);
+	glm::vec4 d = glm::vec4(a.x - s * b.x, a.y - s * b.y, a.z - s * b.z, a.w - s * b.w);
+	float dist = std::sqrt(d.x*d.x + d.y*d.y + d.z*d.z + d.w*d.w);
+	return 4.0f * std::asin(std::min(1.0f, 0.5f * dist));
+}
+
+static float vec3_error(glm::vec3 const &a, glm::vec3 const &b) {
+	glm::vec3 d = glm::abs(a - b);
+	return std::max(d.x, std::max(d.y, d.z));
+}
+
+//Compress one track of samples into keys, appending to 'key_times' and 'key_values'.
+// 'pack' : (sample index) -> packed value
+// 'error' : (sample index, packed key0, packed key1, amount) -> error of interpolated value against sample
+template< typename Pack, typename Error >
+static void compress_track(uint32_t count, float max_error, Pack const &pack, Error const &error, BoneAnimationTrack *track, std::vector< uint16_t > *key_times, std::vector< glm::u16vec3 > *key_values) {
+	track->first_key = uint32_t(key_times->size());
+
+	auto emit = [&](uint32_t i) {
+		key_times->emplace_back(uint16_t(i));
+		key_values->emplace_back(pack(i));
+	};
+
+	//constant track? (a single key is held for every frame)
+	glm::u16vec3 first = pack(0);
+	float constant_error = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		constant_error = std::max(constant_error, error(i, first, first, 0.0f));
+		if (constant_error > max_error) break;
+	}
+	if (constant_error <= max_error) {
+		emit(0);
+		track->key_count = 1;
+		return;
+	}
+
+	uint32_t prev = 0;
+	emit(0);
+	while (prev + 1 < count) {
+		//try to skip ahead to 'next', checking every frame in between:
+		glm::u16vec3 a = pack(prev);
+		uint32_t next = prev + 1;
+		while (next + 1 < count) {
+			uint32_t candidate = next + 1;
+			glm::u16vec3 b = pack(candidate);
+			float candidate_error = 0.0f;
+			for (uint32_t i = prev + 1; i < candidate; ++i) {
+				float amt = float(i - prev) / float(candidate - prev);
+				candidate_error = std::max(candidate_error, error(i, a, b, amt));
+				if (candidate_error > max_error) break;
+			}
+			if (candidate_error > max_error) break;
+			next = candidate;
+		}
+		emit(next);
+		prev = next;
+	}
+
+	track->key_count = uint32_t(key_times->size()) - track->first_key;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try { //windows doesn't print nice errors for unhandled exceptions, so we need to.
+#endif
+	if (argc != 3 && argc != 4) {
+		std::cerr << "Usage:\n\t./compress-banims <in.banims> <out.banims> [max-error]\n";
+		std::cerr << " replaces the every-frame poses in in.banims with compressed, interpolated key tracks and writes the result to out.banims.\n";
+		std::cerr << " max-error (default: 0.001) bounds the difference from the original poses of each track, in position/scale units and rotation radians.\n";
+	std::cerr << "  (it can't go below the precision of packed keys: 1/65535 of a track's range, or about 0.00013 radians)\n";
+		std::cerr.flush();
+		return 1;
+	}
+	std::string inname = argv[1];
+	std::string outname = argv[2];
+	float max_error = 0.001f;
+	if (argc == 4) {
+		std::istringstream error_str(argv[3]);
+		char temp;
+		if (!(error_str >> max_error) || (error_str >> temp) || !(max_error >= 0.0f)) {
+			std::cerr << "ERROR: failed to parse max error (non-negative) from \"" << argv[3] << "\"." << std::endl;
+			return 1;
+		}
+	}
+
+	//----------------------------------
+	//read input (same format as BoneAnimation, in BoneAnimation.cpp):
+
+	std::vector< char > strings;
+	std::vector< BoneInfo > bones;
+	std::vector< PoseBone > frame_bones;
+	std::vector< AnimationInfo > animations;
+	std::vector< char > mesh; //(copied through unchanged)
+	{
+		ChunkReader file(inname);
+		ChunkSpan< char > file_strings = file.read< char >("str0");
+		ChunkSpan< BoneInfo > file_bones = file.read< BoneInfo >("bon0");
+		if (file.peek() != "frm0") {
+			std::cerr << "ERROR: '" << inname << "' has no every-frame poses; is it already compressed?" << std::endl;
+			return 1;
+		}
+		ChunkSpan< PoseBone > file_frame_bones = file.read< PoseBone >("frm0");
+		ChunkSpan< AnimationInfo > file_animations = file.read< AnimationInfo >("act0");
+		ChunkSpan< char > file_mesh = file.read< char >("msh0");
+		if (!file.at_end()) {
+			std::cerr << "WARNING: trailing data in animation file '" << inname << "'" << std::endl;
+		}
+
+		strings.assign(file_strings.begin(), file_strings.end());
+		bones.assign(file_bones.begin(), file_bones.end());
+		frame_bones.assign(file_frame_bones.begin(), file_frame_bones.end());
+		animations.assign(file_animations.begin(), file_animations.end());
+		mesh.assign(file_mesh.begin(), file_mesh.end());
+	}
+
+	if (bones.empty() || frame_bones.size() % bones.size() != 0) {
+		throw std::runtime_error("frame bones is not divisible by bones");
+	}
+	uint32_t frames = uint32_t(frame_bones.size() / bones.size());
+	for (auto const &animation : animations) {
+		if (!(animation.begin < animation.end && animation.end <= frames)) {
+			throw std::runtime_error("animation has empty or out-of-range frames begin/end");
+		}
+		if (animation.end - animation.begin > 0x10000) {
+			throw std::runtime_error("animation is longer than key times can count");
+		}
+	}
+
+	//----------------------------------
+	//compress:
+
+	std::vector< BoneAnimationTrack > tracks;
+	std::vector< uint16_t > key_times;
+	std::vector< glm::u16vec3 > key_values;
+
+	uint32_t constant_tracks = 0;
+	float worst[BoneAnimationTrack::Channels] = { 0.0f, 0.0f, 0.0f };
+
+	for (auto const &animation : animations) {
+		uint32_t count = animation.end - animation.begin;
+		for (uint32_t b = 0; b < bones.size(); ++b) {
+			auto at = [&](uint32_t i) -> PoseBone const & {
+				return frame_bones[(animation.begin + i) * bones.size() + b];
+			};
+
+			auto compress_vec3 = [&](uint32_t channel) {
+				auto get = [&](uint32_t i) -> glm::vec3 const & {
+					return (channel == BoneAnimationTrack::Position ? at(i).position : at(i).scale);
+				};
+				glm::vec3 min = get(0);
+				glm::vec3 max = get(0);
+				for (uint32_t i = 1; i < count; ++i) {
+					min = glm::min(min, get(i));
+					max = glm::max(max, get(i));
+				}
+				BoneAnimationTrack track;
+				track.min = min;
+				track.extent = max - min;
+				auto pack = [&](uint32_t i) {
+					return pack_track_vec3(get(i), track.min, track.extent);
+				};
+				auto error = [&](uint32_t i, glm::u16vec3 const &a, glm::u16vec3 const &b, float amt) {
+					glm::vec3 v = glm::mix(unpack_track_vec3(a, track.min, track.extent), unpack_track_vec3(b, track.min, track.extent), amt);
+					return vec3_error(v, get(i));
+				};
+				compress_track(count, max_error, pack, error, &track, &key_times, &key_values);
+				if (track.key_count == 1) {
+					//single keys don't need a box; store the value exactly:
+					track.min = unpack_track_vec3(key_values.back(), track.min, track.extent);
+					track.extent = glm::vec3(0.0f);
+					key_values.back() = glm::u16vec3(0);
+					++constant_tracks;
+				}
+				//check every frame (including the keys themselves) as BoneAnimation will sample it:
+				for (uint32_t i = 0; i < count; ++i) {
+					glm::vec3 v = sample_track_vec3(track, key_times.data(), key_values.data(), float(i));
+					worst[channel] = std::max(worst[channel], vec3_error(v, get(i)));
+				}
+				return track;
+			};
+
+			auto compress_rotation = [&]() {
+				BoneAnimationTrack track;
+				track.min = track.extent = glm::vec3(0.0f);
+				auto pack = [&](uint32_t i) {
+					return pack_track_quat(at(i).rotation);
+				};
+				auto error = [&](uint32_t i, glm::u16vec3 const &a, glm::u16vec3 const &b, float amt) {
+					glm::quat q = glm::slerp(unpack_track_quat(a), unpack_track_quat(b), amt);
+					return rotation_error(q, glm::normalize(at(i).rotation));
+				};
+				compress_track(count, max_error, pack, error, &track, &key_times, &key_values);
+				if (track.key_count == 1) ++constant_tracks;
+				for (uint32_t i = 0; i < count; ++i) {
+					glm::quat q = sample_track_quat(track, key_times.data(), key_values.data(), float(i));
+					worst[BoneAnimationTrack::Rotation] = std::max(worst[BoneAnimationTrack::Rotation], rotation_error(q, glm::normalize(at(i).rotation)));
+				}
+				return track;
+			};
+
+			//(same order as BoneAnimationTrack::Channel)
+			tracks.emplace_back(compress_vec3(BoneAnimationTrack::Position));
+			tracks.emplace_back(compress_rotation());
+			tracks.emplace_back(compress_vec3(BoneAnimationTrack::Scale));
+		}
+	}
+
+	//pad key chunks so the chunks that follow stay aligned when mapped:
+	while ((key_times.size() * sizeof(uint16_t)) % 4 != 0) key_times.emplace_back(uint16_t(0));
+	while ((key_values.size() * sizeof(glm::u16vec3)) % 4 != 0) key_values.emplace_back(glm::u16vec3(0));
+	while (strings.size() % 4 != 0) strings.emplace_back('\0');
+
+	std::ofstream out(outname, std::ios::binary);
+	write_chunk("str0", strings, &out);
+	write_chunk("bon0", bones, &out);
+	write_chunk("trk0", tracks, &out);
+	write_chunk("ktm0", key_times, &out);
+	write_chunk("kvl0", key_values, &out);
+	write_chunk("act0", animations, &out);
+	write_chunk("msh0", mesh, &out);
+	if (!out) {
+		std::cerr << "ERROR: failed to write '" << outname << "'." << std::endl;
+		return 1;
+	}
+
+	size_t before = frame_bones.size() * sizeof(PoseBone);
+	size_t after = tracks.size() * sizeof(BoneAnimationTrack) + key_times.size() * sizeof(uint16_t) + key_values.size() * sizeof(glm::u16vec3);
+	std::cout << "Compressed " << animations.size() << " animations of " << bones.size() << " bones from " << frames << " frames (" << before << " bytes) to " << tracks.size() << " tracks (" << constant_tracks << " constant) with " << key_times.size() << " keys (" << after << " bytes)." << std::endl;
+	std::cout << "Largest errors: position " << worst[BoneAnimationTrack::Position] << ", rotation " << worst[BoneAnimationTrack::Rotation] << " radians, scale " << worst[BoneAnimationTrack::Scale] << "." << std::endl;
+	std::cout << "Wrote '" << outname << "'." << std::endl;
+
+	return 0;
+#ifdef _WIN32
+	} catch (std::exception &e) {
+		std::cerr << "UNHANDLED EXCEPTION:\n" << e.what() << std::endl;
+		return 1;
+	}
+#endif
+}
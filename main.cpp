@@ -16,6 +16,9 @@
 //for screenshots:
 #include "load_save_png.hpp"
 
+//for toggling the scene render queue:
+#include "Scene.hpp"
+
 //Includes for libSDL:
 #include <SDL.h>
 
@@ -153,6 +156,10 @@ int main(int argc, char **argv) {
 						}
 					}
 
+				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_F5) {
+					// --- toggle scene render queue key (compare with F4) ---
+					Scene::use_render_queue = !Scene::use_render_queue;
+					std::cout << "Scene render queue " << (Scene::use_render_queue ? "enabled" : "disabled") << "." << std::endl;
 				} else if (evt.type == SDL_KEYDOWN && evt.key.keysym.sym == SDLK_PRINTSCREEN) {
 					// --- screenshot key ---
 					std::string filename = "screenshot.png";
@@ -200,6 +207,9 @@ int main(int argc, char **argv) {
 
 	Sound::shutdown();
 
+	//(GL objects must be deleted while the context still exists)
+	Scene::release_instance_buffer();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -0,0 +1,577 @@
+#include "read_write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/*
+ * optimize a mesh file (as written by export-meshes.py) for drawing:
+ *  - triangles are reordered for post-transform vertex cache reuse ("Tipsify"),
+ *  - then clusters of those triangles are reordered to reduce overdraw,
+ *  - then vertices are reordered by first use, for vertex fetch locality.
+ * Unindexed input files are deduplicated; output files are always indexed.
+ * With --quantize, vertices are written in the compact format MeshBuffer
+ *  reads from 'pnq0' chunks (see Mesh.cpp).
+ * The average cache miss ratio (ACMR; transformed vertices per triangle) of
+ *  a simulated FIFO cache is reported before and after.
+ *
+ * The technique follows Sander, Nehab, and Barczak, "Fast Triangle Reordering
+ *  for Vertex Locality and Reduced Overdraw" (SIGGRAPH 2007).
+ *
+ */
+
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+struct QuantizedVertex {
+	uint16_t Position[3]; //16-bit unsigned fraction of mesh bounding box
+	uint16_t Padding;
+	uint32_t Normal; //GL_INT_2_10_10_10_REV signed-normalized xyz (w unused)
+	glm::u8vec4 Color;
+	uint16_t TexCoord[2]; //half floats
+};
+static_assert(sizeof(QuantizedVertex) == 3*2+2+4+4*1+2*2, "QuantizedVertex is packed.");
+
+struct Bounds {
+	glm::vec3 min, max;
+};
+static_assert(sizeof(Bounds) == 2*3*4, "Bounds should be packed");
+
+struct IndexEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+struct ElementRange {
+	uint32_t index_begin, index_end;
+};
+static_assert(sizeof(ElementRange) == 8, "Element range should be packed");
+
+//a mesh being optimized; indices are local to 'vertices':
+struct WorkMesh {
+	std::string name;
+	uint32_t name_begin, name_end; //(in the string chunk, which is copied as-is)
+	std::vector< Vertex > vertices;
+	std::vector< uint32_t > indices;
+};
+
+//count of vertices transformed when drawing 'indices' with a FIFO cache of 'cache_size' entries:
+static uint32_t count_cache_misses(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size) {
+	std::vector< uint32_t > cached_at(vertex_count, 0); //time vertex entered cache (+ cache_size)
+	uint32_t time = cache_size + 1;
+	uint32_t misses = 0;
+	for (uint32_t i : indices) {
+		if (time - cached_at[i] > cache_size) {
+			cached_at[i] = time;
+			++time;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+//average cache miss ratio (transformed vertices per triangle):
+static float compute_acmr(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size) {
+	if (indices.empty()) return 0.0f;
+	return float(count_cache_misses(indices, vertex_count, cache_size)) / float(indices.size() / 3);
+}
+
+//reorder triangles for vertex cache locality ("Tipsify"), filling 'hard_boundaries' with
+// the triangle offsets (in the output) at which the fan had to jump to a dead-end vertex:
+static std::vector< uint32_t > tipsify(std::vector< uint32_t > const &indices, uint32_t vertex_count, uint32_t cache_size, std::vector< uint32_t > *hard_boundaries_) {
+	assert(hard_boundaries_);
+	auto &hard_boundaries = *hard_boundaries_;
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+
+	//vertex -> triangle adjacency:
+	std::vector< uint32_t > live(vertex_count, 0); //count of not-yet-emitted triangles using each vertex
+	for (uint32_t i : indices) live[i] += 1;
+	std::vector< uint32_t > adjacency_begin(vertex_count + 1, 0);
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		adjacency_begin[v+1] = adjacency_begin[v] + live[v];
+	}
+	std::vector< uint32_t > adjacency(indices.size());
+	{
+		std::vector< uint32_t > fill(adjacency_begin.begin(), adjacency_begin.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); ++i) {
+			adjacency[fill[indices[i]]++] = i / 3;
+		}
+	}
+
+	std::vector< uint32_t > cached_at(vertex_count, 0);
+	std::vector< bool > emitted(triangle_count, false);
+	std::vector< uint32_t > dead_end; //stack of recently-used vertices
+	std::vector< uint32_t > candidates;
+
+	std::vector< uint32_t > out;
+	out.reserve(indices.size());
+
+	uint32_t time = cache_size + 1;
+	uint32_t cursor = 0; //next vertex (in input order) to consider when out of other options
+	uint32_t fan = (vertex_count ? 0 : -1U);
+
+	while (fan != -1U) {
+		candidates.clear();
+
+		//emit all remaining triangles around the fanning vertex:
+		for (uint32_t a = adjacency_begin[fan]; a < adjacency_begin[fan+1]; ++a) {
+			uint32_t t = adjacency[a];
+			if (emitted[t]) continue;
+			emitted[t] = true;
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t v = indices[3*t+c];
+				out.emplace_back(v);
+				dead_end.emplace_back(v);
+				candidates.emplace_back(v);
+				live[v] -= 1;
+				if (time - cached_at[v] > cache_size) {
+					cached_at[v] = time;
+					++time;
+				}
+			}
+		}
+
+		//pick next fanning vertex: the candidate that will (probably) still be in the cache when its fan is done, and entered it earliest:
+		uint32_t next = -1U;
+		int32_t best = -1;
+		for (uint32_t v : candidates) {
+			if (live[v] == 0) continue;
+			int32_t priority = 0;
+			if (int32_t(time - cached_at[v]) + 2 * int32_t(live[v]) <= int32_t(cache_size)) {
+				priority = int32_t(time - cached_at[v]);
+			}
+			if (priority > best) {
+				best = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1U) {
+			//dead end: try recently-used vertices, then vertices in input order:
+			while (!dead_end.empty()) {
+				uint32_t v = dead_end.back();
+				dead_end.pop_back();
+				if (live[v] > 0) {
+					next = v;
+					break;
+				}
+			}
+			while (next == -1U && cursor < vertex_count) {
+				if (live[cursor] > 0) next = cursor;
+				++cursor;
+			}
+			if (next != -1U && !out.empty()) {
+				hard_boundaries.emplace_back(uint32_t(out.size() / 3));
+			}
+		}
+		fan = next;
+	}
+
+	assert(out.size() == indices.size());
+	return out;
+}
+
+//reorder clusters of (cache-optimized) triangles so that outward-facing parts of the mesh are drawn first:
+static std::vector< uint32_t > reduce_overdraw(std::vector< uint32_t > const &indices, std::vector< Vertex > const &vertices, std::vector< uint32_t > const &hard_boundaries, uint32_t cache_size, float threshold) {
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+	if (triangle_count == 0) return indices;
+
+	float mesh_acmr = compute_acmr(indices, uint32_t(vertices.size()), cache_size);
+
+	//split into clusters at hard boundaries and wherever the cluster-so-far has a low enough ACMR
+	// (so that cutting there doesn't cost much cache efficiency):
+	std::vector< uint32_t > cluster_begin;
+	{
+		std::vector< uint32_t > cached_at(vertices.size(), 0);
+		uint32_t time = cache_size + 1;
+		uint32_t misses = 0;
+		uint32_t begin = 0;
+		auto next_hard = hard_boundaries.begin();
+		cluster_begin.emplace_back(0);
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			if (next_hard != hard_boundaries.end() && *next_hard == t) {
+				++next_hard;
+				if (t != begin) {
+					cluster_begin.emplace_back(t);
+					begin = t;
+					misses = 0;
+					time += cache_size + 1; //(flush cache)
+				}
+			}
+			for (uint32_t c = 0; c < 3; ++c) {
+				uint32_t v = indices[3*t+c];
+				if (time - cached_at[v] > cache_size) {
+					cached_at[v] = time;
+					++time;
+					++misses;
+				}
+			}
+			if (t + 1 < triangle_count && float(misses) / float(t + 1 - begin) <= threshold * mesh_acmr) {
+				cluster_begin.emplace_back(t + 1);
+				begin = t + 1;
+				misses = 0;
+				time += cache_size + 1; //(flush cache)
+			}
+		}
+	}
+	cluster_begin.emplace_back(triangle_count);
+
+	//compute mesh centroid, and area-weighted cluster centroids and normals:
+	struct Cluster {
+		uint32_t begin, end;
+		float sort_key;
+	};
+	std::vector< Cluster > clusters;
+	clusters.reserve(cluster_begin.size() - 1);
+
+	glm::vec3 mesh_centroid = glm::vec3(0.0f);
+	float mesh_area = 0.0f;
+	std::vector< glm::vec3 > centroids;
+	std::vector< glm::vec3 > normals;
+	for (uint32_t c = 0; c + 1 < cluster_begin.size(); ++c) {
+		glm::vec3 centroid = glm::vec3(0.0f);
+		glm::vec3 normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = cluster_begin[c]; t < cluster_begin[c+1]; ++t) {
+			glm::vec3 const &a = vertices[indices[3*t+0]].Position;
+			glm::vec3 const &b = vertices[indices[3*t+1]].Position;
+			glm::vec3 const &d = vertices[indices[3*t+2]].Position;
+			glm::vec3 n = glm::cross(b - a, d - a);
+			float A = 0.5f * glm::length(n);
+			centroid += A * (a + b + d) / 3.0f;
+			normal += n;
+			area += A;
+		}
+		mesh_centroid += centroid;
+		mesh_area += area;
+		centroids.emplace_back(area > 0.0f ? centroid / area : glm::vec3(0.0f));
+		normals.emplace_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f));
+		clusters.emplace_back(Cluster{cluster_begin[c], cluster_begin[c+1], 0.0f});
+	}
+	if (mesh_area > 0.0f) mesh_centroid /= mesh_area;
+
+	for (uint32_t c = 0; c < clusters.size(); ++c) {
+		clusters[c].sort_key = glm::dot(centroids[c] - mesh_centroid, normals[c]);
+	}
+
+	//clusters far out along their normal are likely to occlude others, so draw them first:
+	std::stable_sort(clusters.begin(), clusters.end(), [](Cluster const &a, Cluster const &b){
+		return a.sort_key > b.sort_key;
+	});
+
+	std::vector< uint32_t > out;
+	out.reserve(indices.size());
+	for (auto const &cluster : clusters) {
+		out.insert(out.end(), indices.begin() + 3 * cluster.begin, indices.begin() + 3 * cluster.end);
+	}
+	return out;
+}
+
+//renumber vertices in order of first use (dropping unused vertices):
+static void reorder_vertices_for_fetch(WorkMesh *mesh_) {
+	assert(mesh_);
+	auto &mesh = *mesh_;
+	std::vector< uint32_t > remap(mesh.vertices.size(), -1U);
+	std::vector< Vertex > vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (uint32_t &i : mesh.indices) {
+		if (remap[i] == -1U) {
+			remap[i] = uint32_t(vertices.size());
+			vertices.emplace_back(mesh.vertices[i]);
+		}
+		i = remap[i];
+	}
+	mesh.vertices = std::move(vertices);
+}
+
+//convert to IEEE half float (rounding to nearest even):
+static uint16_t float_to_half(float f) {
+	uint32_t x;
+	std::memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	int32_t exponent = int32_t((x >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = x & 0x7fffff;
+
+	if (((x >> 23) & 0xff) == 0xff) {
+		return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0)); //inf or nan
+	}
+	if (exponent >= 31) {
+		return uint16_t(sign | 0x7c00); //overflow to inf
+	}
+	if (exponent <= 0) {
+		//subnormal (or zero):
+		if (exponent < -10) return uint16_t(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = uint32_t(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1U << shift) - 1);
+		uint32_t halfway = 1U << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+		return uint16_t(sign | half);
+	}
+	uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half; //(carry into exponent is correct)
+	return uint16_t(half);
+}
+
+//pack a unit vector as GL_INT_2_10_10_10_REV (signed-normalized xyz, w = 0):
+static uint32_t pack_normal(glm::vec3 n) {
+	float len = glm::length(n);
+	if (len > 0.0f) n /= len;
+	uint32_t bits = 0;
+	for (uint32_t c = 0; c < 3; ++c) {
+		int32_t i = int32_t(std::round(std::max(-1.0f, std::min(1.0f, n[c])) * 511.0f));
+		bits |= (uint32_t(i) & 0x3ff) << (10 * c);
+	}
+	return bits;
+}
+
+//quantize a mesh's vertices relative to its bounding box:
+static std::vector< QuantizedVertex > quantize(std::vector< Vertex > const &vertices, Bounds *bounds_) {
+	assert(bounds_);
+	auto &bounds = *bounds_;
+	bounds.min = glm::vec3( std::numeric_limits< float >::infinity());
+	bounds.max = glm::vec3(-std::numeric_limits< float >::infinity());
+	for (auto const &v : vertices) {
+		bounds.min = glm::min(bounds.min, v.Position);
+		bounds.max = glm::max(bounds.max, v.Position);
+	}
+	if (vertices.empty()) {
+		bounds.min = bounds.max = glm::vec3(0.0f);
+	}
+
+	std::vector< QuantizedVertex > out;
+	out.reserve(vertices.size());
+	for (auto const &v : vertices) {
+		QuantizedVertex q;
+		for (uint32_t c = 0; c < 3; ++c) {
+			float range = bounds.max[c] - bounds.min[c];
+			float t = (range > 0.0f ? (v.Position[c] - bounds.min[c]) / range : 0.0f);
+			q.Position[c] = uint16_t(std::round(std::max(0.0f, std::min(1.0f, t)) * 65535.0f));
+		}
+		q.Padding = 0;
+		q.Normal = pack_normal(v.Normal);
+		q.Color = v.Color;
+		q.TexCoord[0] = float_to_half(v.TexCoord.x);
+		q.TexCoord[1] = float_to_half(v.TexCoord.y);
+		out.emplace_back(q);
+	}
+	return out;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try { //windows doesn't print nice errors for unhandled exceptions, so we need to.
+#endif
+	bool quantize_output = false;
+	std::vector< std::string > args;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--quantize") quantize_output = true;
+		else args.emplace_back(argv[i]);
+	}
+	if (args.size() != 2 && args.size() != 3) {
+		std::cerr << "Usage:\n\t./optimize-meshes [--quantize] <in.pnct> <out.pnct> [cache-size]\n";
+		std::cerr << " reorders the triangles and vertices of every mesh in in.pnct for vertex cache reuse, reduced overdraw, and vertex fetch locality, and writes the (indexed) result to out.pnct.\n";
+		std::cerr << " --quantize writes 20-byte vertices (16-bit positions, 10-bit normals, half-float texcoords) instead of 36-byte vertices.\n";
+		std::cerr << " cache-size (default: 16) is the size of the simulated FIFO post-transform cache.\n";
+		std::cerr.flush();
+		return 1;
+	}
+	std::string inname = args[0];
+	std::string outname = args[1];
+	uint32_t cache_size = 16;
+	if (args.size() == 3) {
+		std::istringstream cache_str(args[2]);
+		char temp;
+		if (!(cache_str >> cache_size) || (cache_str >> temp) || cache_size < 3) {
+			std::cerr << "ERROR: failed to parse cache size (at least 3) from \"" << args[2] << "\"." << std::endl;
+			return 1;
+		}
+	}
+	//clusters may be cut where their ACMR is at most this much worse than the whole mesh's:
+	float const overdraw_threshold = 1.05f;
+
+	//----------------------------------
+	//read input (same format as MeshBuffer, in Mesh.cpp):
+
+	std::vector< WorkMesh > meshes;
+	std::vector< char > strings_in;
+	{
+		ChunkReader file(inname);
+		if (file.peek() == "pnq0") {
+			std::cerr << "ERROR: '" << inname << "' is already quantized; optimize the unquantized mesh file instead." << std::endl;
+			return 1;
+		}
+		ChunkSpan< Vertex > data = file.read< Vertex >("pnct");
+		ChunkSpan< char > strings = file.read< char >("str0");
+		ChunkSpan< IndexEntry > index = file.read< IndexEntry >("idx0");
+
+		ChunkSpan< ElementRange > ranges;
+		ChunkSpan< uint32_t > elements;
+		if (file.peek() == "elr0") {
+			ranges = file.read< ElementRange >("elr0");
+			elements = file.read< uint32_t >("ele0");
+			if (ranges.size() != index.size()) {
+				throw std::runtime_error("element range chunk does not match index chunk");
+			}
+		}
+		if (!file.at_end()) {
+			std::cerr << "WARNING: trailing data in mesh file '" << inname << "'" << std::endl;
+		}
+
+		for (uint32_t m = 0; m < index.size(); ++m) {
+			IndexEntry const &entry = index[m];
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+				throw std::runtime_error("index entry has out-of-range name begin/end");
+			}
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= data.size())) {
+				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			}
+			meshes.emplace_back();
+			WorkMesh &mesh = meshes.back();
+			mesh.name = std::string(strings.begin() + entry.name_begin, strings.begin() + entry.name_end);
+			mesh.name_begin = entry.name_begin;
+			mesh.name_end = entry.name_end;
+
+			if (!ranges.empty()) {
+				ElementRange const &range = ranges[m];
+				if (!(range.index_begin <= range.index_end && range.index_end <= elements.size())) {
+					throw std::runtime_error("element range has out-of-range index begin/end");
+				}
+				mesh.vertices.assign(data.begin() + entry.vertex_begin, data.begin() + entry.vertex_end);
+				for (uint32_t e = range.index_begin; e < range.index_end; ++e) {
+					if (!(entry.vertex_begin <= elements[e] && elements[e] < entry.vertex_end)) {
+						throw std::runtime_error("element refers to vertex outside of its mesh's vertex range");
+					}
+					mesh.indices.emplace_back(elements[e] - entry.vertex_begin);
+				}
+			} else {
+				//unindexed: share identical vertices:
+				std::map< std::string, uint32_t > unique;
+				for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+					std::string key(reinterpret_cast< char const * >(&data[v]), sizeof(Vertex));
+					auto f = unique.insert(std::make_pair(key, uint32_t(mesh.vertices.size())));
+					if (f.second) mesh.vertices.emplace_back(data[v]);
+					mesh.indices.emplace_back(f.first->second);
+				}
+			}
+			if (mesh.indices.size() % 3 != 0) {
+				throw std::runtime_error("mesh '" + mesh.name + "' is not made of triangles");
+			}
+		}
+
+		strings_in.assign(strings.begin(), strings.end());
+	}
+
+	//----------------------------------
+	//optimize each mesh:
+
+	uint32_t total_triangles = 0;
+	uint32_t total_misses_before = 0;
+	uint32_t total_misses_after = 0;
+
+	for (auto &mesh : meshes) {
+		uint32_t triangles = uint32_t(mesh.indices.size() / 3);
+		uint32_t misses_before = count_cache_misses(mesh.indices, uint32_t(mesh.vertices.size()), cache_size);
+		float before = compute_acmr(mesh.indices, uint32_t(mesh.vertices.size()), cache_size);
+
+		std::vector< uint32_t > hard_boundaries;
+		mesh.indices = tipsify(mesh.indices, uint32_t(mesh.vertices.size()), cache_size, &hard_boundaries);
+		float tipsified = compute_acmr(mesh.indices, uint32_t(mesh.vertices.size()), cache_size);
+		mesh.indices = reduce_overdraw(mesh.indices, mesh.vertices, hard_boundaries, cache_size, overdraw_threshold);
+		reorder_vertices_for_fetch(&mesh);
+
+		uint32_t misses_after = count_cache_misses(mesh.indices, uint32_t(mesh.vertices.size()), cache_size);
+		float after = compute_acmr(mesh.indices, uint32_t(mesh.vertices.size()), cache_size);
+
+		std::cout << "'" << mesh.name << "': " << triangles << " triangles, " << mesh.vertices.size() << " vertices; ACMR " << before << " -> " << tipsified << " (cache) -> " << after << " (overdraw)\n";
+
+		total_triangles += triangles;
+		total_misses_before += misses_before;
+		total_misses_after += misses_after;
+	}
+	if (total_triangles) {
+		std::cout << "Overall ACMR (cache size " << cache_size << "): " << float(total_misses_before) / total_triangles << " -> " << float(total_misses_after) / total_triangles << "\n";
+	}
+	std::cout.flush();
+
+	//----------------------------------
+	//write output (same format as export-meshes.py):
+
+	std::vector< Vertex > data;
+	std::vector< QuantizedVertex > quantized_data;
+	std::vector< Bounds > bounds;
+	std::vector< IndexEntry > index;
+	std::vector< ElementRange > ranges;
+	std::vector< uint32_t > elements;
+
+	for (auto const &mesh : meshes) {
+		IndexEntry entry;
+		entry.name_begin = mesh.name_begin;
+		entry.name_end = mesh.name_end;
+		entry.vertex_begin = uint32_t(data.size());
+		ElementRange range;
+		range.index_begin = uint32_t(elements.size());
+		for (uint32_t i : mesh.indices) {
+			elements.emplace_back(entry.vertex_begin + i);
+		}
+		if (quantize_output) {
+			bounds.emplace_back();
+			std::vector< QuantizedVertex > quantized = quantize(mesh.vertices, &bounds.back());
+			quantized_data.insert(quantized_data.end(), quantized.begin(), quantized.end());
+		}
+		data.insert(data.end(), mesh.vertices.begin(), mesh.vertices.end());
+		entry.vertex_end = uint32_t(data.size());
+		range.index_end = uint32_t(elements.size());
+
+		index.emplace_back(entry);
+		ranges.emplace_back(range);
+	}
+
+	//pad strings so that the chunks that follow stay aligned when mapped:
+	while (strings_in.size() % 4 != 0) strings_in.emplace_back('\0');
+
+	std::ofstream out(outname, std::ios::binary);
+	if (quantize_output) {
+		write_chunk("pnq0", quantized_data, &out);
+	} else {
+		write_chunk("pnct", data, &out);
+	}
+	write_chunk("str0", strings_in, &out);
+	write_chunk("idx0", index, &out);
+	if (quantize_output) {
+		write_chunk("bnd0", bounds, &out);
+	}
+	write_chunk("elr0", ranges, &out);
+	write_chunk("ele0", elements, &out);
+	if (!out) {
+		std::cerr << "ERROR: failed to write '" << outname << "'." << std::endl;
+		return 1;
+	}
+
+	std::cout << "Wrote " << meshes.size() << " meshes (" << data.size() << (quantize_output ? " quantized" : "") << " vertices, " << elements.size() << " indices) to '" << outname << "'." << std::endl;
+
+	return 0;
+#ifdef _WIN32
+	} catch (std::exception &e) {
+		std::cerr << "UNHANDLED EXCEPTION:\n" << e.what() << std::endl;
+		return 1;
+	}
+#endif
+}
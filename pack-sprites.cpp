@@ -364,6 +364,9 @@ int main(int argc, char **argv) {
 			);
 		}
 
+		//pad strings so that the sprite data stays aligned when mapped:
+		while (strings.size() % 4 != 0) strings.emplace_back('\0');
+
 		std::ofstream out(outname + ".atlas", std::ios::binary);
 		write_chunk("str0", strings, &out);
 		write_chunk("spr0", datas, &out);
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "MappedFile.hpp"
+
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <stdexcept>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
@@ -63,3 +69,91 @@ void write_chunk(std::string const &magic, std::vector< T > const &from, std::os
 	to.write(reinterpret_cast< const char * >(&header), sizeof(header));
 	to.write(reinterpret_cast< const char * >(from.data()), from.size() * sizeof(T));
 }
+
+
+//ChunkSpan< T > is a view of the elements of a chunk read by ChunkReader:
+template< typename T >
+struct ChunkSpan {
+	T const *first = nullptr;
+	size_t count = 0;
+
+	T const *data() const { return first; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const &operator[](size_t i) const { assert(i < count); return first[i]; }
+	T const *begin() const { return first; }
+	T const *end() const { return first + count; }
+};
+
+//ChunkReader maps a whole file and reads chunks (in the format above) in place, without copying:
+// - spans returned by read() are valid as long as the reader exists
+// - chunk data that isn't suitably aligned for T (e.g., following an odd-sized string chunk)
+//   is copied to aligned storage owned by the reader, so reading always succeeds when read_chunk would
+struct ChunkReader {
+	//map 'filename'; throws on failure:
+	ChunkReader(std::string const &filename) : file(filename) { }
+
+	//read the next chunk, which must have the given magic number; throws on mismatch or bad size:
+	// (error messages include the file name and expected magic number)
+	template< typename T >
+	ChunkSpan< T > read(std::string const &magic);
+
+	//magic number of the next chunk (or "" if there is no next chunk):
+	std::string peek() const {
+		if (at + 8 > file.size) return "";
+		return std::string(file.data + at, 4);
+	}
+
+	//is all of the file consumed?
+	bool at_end() const { return at >= file.size; }
+
+	MappedFile file;
+	size_t at = 0; //offset of next chunk header
+
+	//aligned copies of misaligned chunks:
+	std::vector< std::unique_ptr< std::max_align_t[] > > copies;
+};
+
+template< typename T >
+ChunkSpan< T > ChunkReader::read(std::string const &magic) {
+	assert(magic.size() == 4);
+	static_assert(alignof(T) <= alignof(std::max_align_t), "chunk elements are not over-aligned");
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	ChunkHeader header;
+	if (at + sizeof(header) > file.size) {
+		throw std::runtime_error("file '" + file.filename + "' is truncated (expecting '" + magic + "' chunk)");
+	}
+	std::memcpy(&header, file.data + at, sizeof(header));
+	if (std::string(header.magic,4) != magic) {
+		throw std::runtime_error("file '" + file.filename + "' has unexpected chunk (expecting '" + magic + "')");
+	}
+
+	if (header.size % sizeof(T) != 0) {
+		throw std::runtime_error("file '" + file.filename + "' has '" + magic + "' chunk with size not divisible by element size");
+	}
+
+	char const *data = file.data + at + sizeof(header);
+	if (header.size > file.size - (at + sizeof(header))) {
+		throw std::runtime_error("file '" + file.filename + "' has truncated '" + magic + "' chunk");
+	}
+	at += sizeof(header) + header.size;
+
+	ChunkSpan< T > ret;
+	ret.count = header.size / sizeof(T);
+	if (ret.count == 0) return ret;
+
+	if (reinterpret_cast< uintptr_t >(data) % alignof(T) != 0) {
+		size_t words = (header.size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+		copies.emplace_back(new std::max_align_t[words]);
+		std::memcpy(copies.back().get(), data, header.size);
+		data = reinterpret_cast< char const * >(copies.back().get());
+	}
+	ret.first = reinterpret_cast< T const * >(data);
+	return ret;
+}
@@ -331,6 +331,10 @@ def write_chunk(magic, data):
 	blob.write(struct.pack('I', len(data))) #length
 	blob.write(data)
 
+#(strings are padded to a multiple of four bytes so later chunks stay aligned when mapped)
+while len(strings_data) % 4 != 0:
+	strings_data += b'\0'
+
 write_chunk(b'str0', strings_data)
 write_chunk(b'bon0', bone_data)
 write_chunk(b'frm0', frame_data)
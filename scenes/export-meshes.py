@@ -79,6 +79,13 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#elements holds (32-bit) vertex indices for each mesh's triangles:
+elements = b''
+
+#element_ranges gives offsets into elements for each mesh (in the same order as index):
+element_ranges = b''
+element_count = 0
+
 vertex_count = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
@@ -136,42 +143,59 @@ for obj in bpy.data.objects:
 	else:
 		uvs = obj.data.uv_layers.active.data
 
-	#write the mesh triangles:
+	element_ranges += struct.pack('I', element_count) #index_begin
+
+	#write the mesh triangles, sharing identical vertices:
+	# (vertex bytes -> index of that vertex in data)
+	unique = dict()
 	for poly in mesh.polygons:
 		assert(len(poly.loop_indices) == 3)
 		for i in range(0,3):
 			assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
 			loop = mesh.loops[poly.loop_indices[i]]
 			vertex = mesh.vertices[loop.vertex_index]
+			v = b''
 			for x in vertex.co:
-				data += struct.pack('f', x)
+				v += struct.pack('f', x)
 			for x in loop.normal:
-				data += struct.pack('f', x)
+				v += struct.pack('f', x)
 			if colors != None:
 				col = colors[poly.loop_indices[i]].color
-				data += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), int(col[3] * 255))
+				v += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), int(col[3] * 255))
 			else:
-				data += struct.pack('BBBB', 255, 255, 255, 255)
+				v += struct.pack('BBBB', 255, 255, 255, 255)
 			if uvs != None:
 				uv = uvs[poly.loop_indices[i]].uv
-				data += struct.pack('ff', uv.x, uv.y)
+				v += struct.pack('ff', uv.x, uv.y)
 			else:
-				data += struct.pack('ff', 0, 0)
-	vertex_count += len(mesh.polygons) * 3
+				v += struct.pack('ff', 0, 0)
+			if v not in unique:
+				unique[v] = vertex_count
+				data += v
+				vertex_count += 1
+			elements += struct.pack('I', unique[v])
+	element_count += len(mesh.polygons) * 3
+
+	print("  " + str(len(mesh.polygons) * 3) + " corners share " + str(len(unique)) + " vertices.")
 
 	index += struct.pack('I', vertex_count) #vertex_end
+	element_ranges += struct.pack('I', element_count) #index_end
 
 
 #check that code created as much data as anticipated:
 assert(vertex_count * (4*3+4*3+4*1+4*2) == len(data))
+assert(element_count * 4 == len(elements))
 
-#write the data chunk and index chunk to an output blob:
+#write the data, string, index, and element chunks to an output blob:
 blob = open(outfile, 'wb')
 #first chunk: the data
 blob.write(struct.pack('4s',b'pnct')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
 #second chunk: the strings
+#(padded to a multiple of four bytes so the index that follows stays aligned when mapped)
+while len(strings) % 4 != 0:
+	strings += b'\0'
 blob.write(struct.pack('4s',b'str0')) #type
 blob.write(struct.pack('I', len(strings))) #length
 blob.write(strings)
@@ -179,7 +203,15 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'idx0')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
+#fourth chunk: the element ranges (parallel to the index)
+blob.write(struct.pack('4s',b'elr0')) #type
+blob.write(struct.pack('I', len(element_ranges))) #length
+blob.write(element_ranges)
+#fifth chunk: the elements
+blob.write(struct.pack('4s',b'ele0')) #type
+blob.write(struct.pack('I', len(elements))) #length
+blob.write(elements)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index + " + str(len(element_ranges)+8) + " bytes of element ranges + " + str(len(elements)+8) + " bytes of elements] to '" + outfile + "'")
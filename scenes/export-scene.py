@@ -51,32 +51,43 @@ if collection_name:
 else:
 	collection = bpy.context.scene.collection
 
-#Scene file format:
-# str0 len < char > * [strings chunk]
-# xfh0 len < ... > * [transform hierarchy]
+#Scene file format (version 2):
+# scn2 4 < uint > [version number (2)]
+# str1 len < char > * [strings chunk; each distinct string stored once; zero-padded to a multiple of four bytes]
+# prn1 len < int > * [parent index of each transform, or -1; parents always come before their children]
+# nam1 len < uint uint > * [name (begin,end) of each transform]
+# xfm1 len < ... > * [position, rotation, scale of each transform]
 # msh0 len < uint uint uint > [hierarchy point + mesh name]
 # cam0 len < uint params > [heirarchy point + camera params]
-# lig0 len < uint params > [hierarchy point + light params]
+# lmp0 len < uint params > [hierarchy point + light params]
+#All chunks are a multiple of four bytes long, so the file can be mapped and used in place.
 
 strings_data = b""
-xfh_data = b""
+parent_data = b""
+name_data = b""
+xfm_data = b""
 mesh_data = b""
 camera_data = b""
 lamp_data = b""
 
-#write_string will add a string to the strings section and return a packed (begin,end) reference:
+string_refs = dict()
+
+#write_string will add a string to the strings section (if not already there) and return a packed (begin,end) reference:
 def write_string(string):
 	global strings_data
+	if string in string_refs: return string_refs[string]
 	begin = len(strings_data)
 	strings_data += bytes(string, 'utf8')
 	end = len(strings_data)
-	return struct.pack('II', begin, end)
+	ref = struct.pack('II', begin, end)
+	string_refs[string] = ref
+	return ref
 
 obj_to_xfh = dict()
 
 #write_xfh will add an object [and its parents] to the hierarchy section and return a packed (idx) reference:
 def write_xfh(obj):
-	global xfh_data
+	global parent_data, name_data, xfm_data
 	if obj in obj_to_xfh: return obj_to_xfh[obj]
 	if obj.parent == None:
 		parent_ref = struct.pack('i', -1)
@@ -91,11 +102,11 @@ def write_xfh(obj):
 	transform = (world_to_parent @ obj.matrix_world).decompose()
 	#print(repr(transform))
 
-	xfh_data += parent_ref
-	xfh_data += write_string(obj.name)
-	xfh_data += struct.pack('3f', transform[0].x, transform[0].y, transform[0].z)
-	xfh_data += struct.pack('4f', transform[1].x, transform[1].y, transform[1].z, transform[1].w)
-	xfh_data += struct.pack('3f', transform[2].x, transform[2].y, transform[2].z)
+	parent_data += parent_ref
+	name_data += write_string(obj.name)
+	xfm_data += struct.pack('3f', transform[0].x, transform[0].y, transform[0].z)
+	xfm_data += struct.pack('4f', transform[1].x, transform[1].y, transform[1].z, transform[1].w)
+	xfm_data += struct.pack('3f', transform[2].x, transform[2].y, transform[2].z)
 
 	return ref
 
@@ -194,8 +205,15 @@ def write_chunk(magic, data):
 	blob.write(struct.pack('I', len(data))) #length
 	blob.write(data)
 
-write_chunk(b'str0', strings_data)
-write_chunk(b'xfh0', xfh_data)
+#pad strings so that following chunks stay four-byte aligned:
+while len(strings_data) % 4 != 0:
+	strings_data += b"\0"
+
+write_chunk(b'scn2', struct.pack('I', 2))
+write_chunk(b'str1', strings_data)
+write_chunk(b'prn1', parent_data)
+write_chunk(b'nam1', name_data)
+write_chunk(b'xfm1', xfm_data)
 write_chunk(b'msh0', mesh_data)
 write_chunk(b'cam0', camera_data)
 write_chunk(b'lmp0', lamp_data)